@@ -1,7 +1,17 @@
 # get the name of the test file
 name=$1
+# --check: compare the scops with isl, no code generation
+if [ "$2" = "--check" ]; then
+cp ./testcases/$name.c ./testspace/input.c && \
+./build/transformer --check ./testcases/$name.c.clay.scop ./testspace/input.c
+exit $?
+fi
 cp ./testcases/$name.c ./testspace/input.c && \
 cp ./testcases/$name.c.clay.scop ./testspace/result.scop && \
 ./build/transformer ./testspace/input.c && \
 ./build/codegen ./testspace/result.scop ./testspace/result.c && \
-diff ./testspace/result.c ./testspace/output.c
\ No newline at end of file
+diff ./testspace/result.c ./testspace/output.c || exit 1
+# hand-checked code for the case, if any
+if [ -f ./testcases/$name.c.expected.c ]; then
+diff ./testcases/$name.c.expected.c ./testspace/output.c
+fi
@@ -0,0 +1,218 @@
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "utility.h"
+
+using namespace std;
+
+// "no bound" for the intervals below
+#define BOUND_INF (LLONG_MAX / 4)
+// value of the parameters the user did not give
+#define DEFAULT_PARAM 100
+
+// an access relation read as a function of the iterators
+// dims[d] holds the coefficients of the d-th subscript:
+// iterators first, then parameters, then the constant
+struct AccessFunction {
+    int array;
+    int type;
+    vector<vector<long long>> dims;
+};
+
+// the value of the entry (row, col) of a relation
+inline long long entry(osl_relation_p relation, int row, int col) {
+    return osl_int_get_si(relation->precision, relation->m[row][col]);
+}
+
+// read an access relation produced by Clan: one equality per output
+// dimension, with a unit coefficient on it and no local dimension
+inline bool access_function(osl_relation_p access, AccessFunction& f) {
+    if (access == NULL || access->next != NULL || access->nb_local_dims > 0)
+        return false;
+    int out = access->nb_output_dims;
+    int in = access->nb_input_dims;
+    int params = access->nb_parameters;
+    int constant_pos = access->nb_columns - 1;
+    if (out < 1 || access->nb_rows != out) return false;
+
+    f.type = access->type;
+    f.dims.assign(out - 1, vector<long long>(in + params + 1, 0));
+    for (int d = 0; d < out; ++d) {
+        int row = find_row(access, d);
+        if (row < 0 || !osl_int_zero(access->precision, access->m[row][0]))
+            return false;
+        // the row must not involve another output dimension
+        for (int k = 0; k < out; ++k)
+            if (k != d && entry(access, row, k + 1) != 0) return false;
+        long long coeff = entry(access, row, d + 1);
+        if (coeff != 1 && coeff != -1) return false;
+        // coeff * a_d + rest = 0  =>  a_d = -coeff * rest
+        if (d == 0) {
+            f.array = -coeff * entry(access, row, constant_pos);
+            continue;
+        }
+        auto& dim = f.dims[d - 1];
+        for (int k = 0; k < in; ++k)
+            dim[k] = -coeff * entry(access, row, 1 + out + k);
+        for (int k = 0; k < params; ++k)
+            dim[in + k] = -coeff * entry(access, row, 1 + out + in + k);
+        dim[in + params] = -coeff * entry(access, row, constant_pos);
+    }
+    return true;
+}
+
+// the name of an array id, from the "arrays" extension of the scop
+inline string array_name(osl_scop_p scop, int id) {
+    osl_arrays_p arrays =
+        (osl_arrays_p)osl_generic_lookup(scop->extension, OSL_URI_ARRAYS);
+    if (arrays != NULL)
+        for (int i = 0; i < arrays->nb_names; ++i)
+            if (arrays->id[i] == id) return arrays->names[i];
+    return "A" + to_string(id);
+}
+
+// the parameter names of the scop
+inline vector<string> parameter_names(osl_scop_p scop) {
+    vector<string> names;
+    if (scop->parameters == NULL) return names;
+    osl_strings_p strings = (osl_strings_p)scop->parameters->data;
+    for (char** p = strings->string; p != NULL && *p != NULL; ++p)
+        names.push_back(*p);
+    return names;
+}
+
+// the values of the parameters of the scop, in order, taken from values
+inline vector<long> parameter_values(osl_scop_p scop,
+                                     const map<string, long>& values) {
+    vector<long> params;
+    for (auto& name : parameter_names(scop)) {
+        auto it = values.find(name);
+        params.push_back(it == values.end() ? DEFAULT_PARAM : it->second);
+    }
+    return params;
+}
+
+inline long long floor_div(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+inline long long ceil_div(long long a, long long b) {
+    return -floor_div(-a, b);
+}
+
+// interval of an affine expression over a box, the expression holds the
+// coefficients of the box variables, then the parameters, then the constant
+// return false if the expression is unbounded on the box
+inline bool affine_interval(const vector<long long>& expr,
+                            const vector<long long>& lo,
+                            const vector<long long>& hi,
+                            const vector<long>& params, long long& min_val,
+                            long long& max_val) {
+    int n = lo.size();
+    min_val = max_val = expr.back();
+    for (size_t p = 0; p < params.size() && n + p + 1 < expr.size(); ++p) {
+        min_val += expr[n + p] * params[p];
+        max_val += expr[n + p] * params[p];
+    }
+    for (int k = 0; k < n; ++k) {
+        if (expr[k] == 0) continue;
+        if (lo[k] <= -BOUND_INF || hi[k] >= BOUND_INF) return false;
+        long long a = expr[k] * lo[k], b = expr[k] * hi[k];
+        min_val += min(a, b);
+        max_val += max(a, b);
+    }
+    return true;
+}
+
+// bounding box of the iterators of a domain for given parameter values
+// unbounded sides stay at -BOUND_INF / BOUND_INF
+// return false if the domain is empty for these parameters
+inline bool domain_box(osl_relation_p domain, const vector<long>& params,
+                       vector<long long>& lo, vector<long long>& hi) {
+    int n = domain->nb_output_dims;
+    vector<long long> all_lo(n, BOUND_INF), all_hi(n, -BOUND_INF);
+    bool non_empty = false;
+
+    // the box of a union is the hull of the boxes of its parts
+    for (auto part = domain; part != NULL; part = part->next) {
+        vector<long long> plo(n, -BOUND_INF), phi(n, BOUND_INF);
+        int locals = part->nb_local_dims;
+        int params_pos = 1 + n + locals;
+        int constant_pos = part->nb_columns - 1;
+
+        // propagate the rows until the box is stable
+        bool changed = true;
+        for (int pass = 0; changed && pass <= 2 * n + 1; ++pass) {
+            changed = false;
+            for (int row = 0; row < part->nb_rows; ++row) {
+                bool uses_locals = false;
+                for (int l = 0; l < locals; ++l)
+                    uses_locals |= entry(part, row, 1 + n + l) != 0;
+                if (uses_locals) continue;
+
+                vector<long long> expr(n + 1 + params.size(), 0);
+                for (int k = 0; k < n; ++k) expr[k] = entry(part, row, 1 + k);
+                for (size_t p = 0; p < params.size(); ++p)
+                    if (params_pos + (int)p < constant_pos)
+                        expr[n + p] = entry(part, row, params_pos + p);
+                expr.back() = entry(part, row, constant_pos);
+                bool equality = entry(part, row, 0) == 0;
+
+                // an equality is two opposite inequalities
+                for (int sign = 1; sign >= (equality ? -1 : 1); sign -= 2) {
+                    for (int k = 0; k < n; ++k) {
+                        long long a = sign * expr[k];
+                        if (a == 0) continue;
+                        vector<long long> rest = expr;
+                        for (auto& v : rest) v *= sign;
+                        rest[k] = 0;
+                        long long rest_min, rest_max;
+                        if (!affine_interval(rest, plo, phi, params, rest_min,
+                                             rest_max))
+                            continue;
+                        // a * x + rest >= 0
+                        if (a > 0) {
+                            long long b = ceil_div(-rest_max, a);
+                            if (b > plo[k]) {
+                                plo[k] = b;
+                                changed = true;
+                            }
+                        } else {
+                            long long b = floor_div(rest_max, -a);
+                            if (b < phi[k]) {
+                                phi[k] = b;
+                                changed = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        bool empty = false;
+        for (int k = 0; k < n; ++k) empty |= plo[k] > phi[k];
+        if (empty) continue;
+        non_empty = true;
+        for (int k = 0; k < n; ++k) {
+            all_lo[k] = min(all_lo[k], plo[k]);
+            all_hi[k] = max(all_hi[k], phi[k]);
+        }
+    }
+    lo = all_lo;
+    hi = all_hi;
+    return non_empty;
+}
+
+#endif
@@ -0,0 +1,278 @@
+/* bench.cpp measure the runtime of the transformed kernels of a C file
+ *
+ * every SCoP region of the file is wrapped, as written and as generated
+ * after its Clay script, into a kernel of the same driver (see kernel.cpp),
+ * the driver is built with the local C compiler, checks that both kernels
+ * leave the same values in the arrays and times them
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "affine.h"
+#include "gpt.h"
+#include "process.h"
+#include "raii.h"
+
+using namespace std;
+
+// relative error tolerated between the original and the transformed arrays
+#define BENCH_TOLERANCE 1e-9
+
+// a cycle counter for the kernels (kernel_prelude() has the macros of the
+// CLooG output), the monotonic clock (in ns) where there is no TSC
+static const char* driver_header =
+    "#if defined(__x86_64__) || defined(__i386__)\n"
+    "#include <x86intrin.h>\n"
+    "#define GPT_CYCLES() ((double)__rdtsc())\n"
+    "#else\n"
+    "#include <time.h>\n"
+    "static double GPT_CYCLES(void) {\n"
+    "  struct timespec t;\n"
+    "  clock_gettime(CLOCK_MONOTONIC, &t);\n"
+    "  return t.tv_sec * 1e9 + t.tv_nsec;\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "static long gpt_count;\n"
+    "\n";
+
+// run the kernels, compare the arrays and print
+// "<iterations> <original cycles> <transformed cycles> <max error>"
+static const char* driver_main =
+    "typedef void (*gpt_kernel)(const long*, double**, const long*);\n"
+    "\n"
+    "static double** gpt_alloc(void) {\n"
+    "  double** a = malloc(sizeof(double*) * (GPT_NB_ARRAYS + 1));\n"
+    "  for (int k = 0; k < GPT_NB_ARRAYS; ++k)\n"
+    "    a[k] = malloc(sizeof(double) * (gpt_sizes[k] + 1));\n"
+    "  return a;\n"
+    "}\n"
+    "\n"
+    "static void gpt_init(double** a) {\n"
+    "  for (int k = 0; k < GPT_NB_ARRAYS; ++k)\n"
+    "    for (long i = 0; i < gpt_sizes[k]; ++i)\n"
+    "      a[k][i] = 1.0 + (double)((i * 7 + k * 13) % 101) / 101.0;\n"
+    "}\n"
+    "\n"
+    "int main(int argc, char** argv) {\n"
+    "  int reps = argc > 1 ? atoi(argv[1]) : 5;\n"
+    "  gpt_kernel kernels[2] = {gpt_original, gpt_transformed};\n"
+    "  double** a = gpt_alloc();\n"
+    "  double** b = gpt_alloc();\n"
+    "\n"
+    "  gpt_init(a);\n"
+    "  gpt_iterations(gpt_params, a, gpt_shape);\n"
+    "  gpt_init(a);\n"
+    "  gpt_original(gpt_params, a, gpt_shape);\n"
+    "  gpt_init(b);\n"
+    "  gpt_transformed(gpt_params, b, gpt_shape);\n"
+    "  double error = 0;\n"
+    "  for (int k = 0; k < GPT_NB_ARRAYS; ++k)\n"
+    "    for (long i = 0; i < gpt_sizes[k]; ++i) {\n"
+    "      double x = a[k][i], y = b[k][i];\n"
+    "      double scale = fmax(1.0, fmax(fabs(x), fabs(y)));\n"
+    "      double e = x == y ? 0 : fabs(x - y) / scale;\n"
+    "      if (!(e <= error)) error = e;\n"
+    "    }\n"
+    "\n"
+    "  double best[2] = {HUGE_VAL, HUGE_VAL};\n"
+    "  for (int r = 0; r < reps; ++r)\n"
+    "    for (int v = 0; v < 2; ++v) {\n"
+    "      gpt_init(a);\n"
+    "      double start = GPT_CYCLES();\n"
+    "      kernels[v](gpt_params, a, gpt_shape);\n"
+    "      double cycles = GPT_CYCLES() - start;\n"
+    "      if (cycles < best[v]) best[v] = cycles;\n"
+    "    }\n"
+    "  printf(\"%ld %.0f %.0f %g\\n\", gpt_count, best[0], best[1], error);\n"
+    "  return 0;\n"
+    "}\n";
+
+struct BenchOptions {
+    int reps = 5;
+    string cc = "cc";
+    string cflags = "-O2";
+    bool keep = false;
+    map<string, long> params;
+};
+
+// a C array initializer, never empty
+static string c_array(const vector<long>& values) {
+    string ret = "{";
+    for (auto v : values) ret += to_string(v) + ", ";
+    return ret + "0}";
+}
+
+// the scop with every statement body replaced by a counter increment
+static string count_code(osl_scop_p scop) {
+    OwnedScop count = clone_scop(scop);
+    for (auto s = count->statement; s != NULL; s = s->next) {
+        osl_body_p body =
+            (osl_body_p)osl_generic_lookup(s->extension, OSL_URI_BODY);
+        if (body == NULL) continue;
+        osl_strings_free(body->expression);
+        body->expression = osl_strings_encapsulate(strdup("gpt_count++;"));
+        osl_generic_remove(&s->extension, OSL_URI_EXTBODY);
+    }
+    return print_scop_to_string(count.get());
+}
+
+// the whole driver for one scop, original is its C text from the file
+static bool driver_source(osl_scop_p scop, const string& original,
+                          const BenchOptions& opt, string& src) {
+    vector<long> params = parameter_values(scop, opt.params);
+    KernelLayout layout;
+    if (!kernel_layout(scop, params, layout)) return false;
+
+    // the transformation does not change the arrays, only the schedule
+    OwnedScop transformed = clone_scop(scop);
+    if (apply_clay(transformed.get()) != 0) return false;
+    string code = print_scop_to_string(transformed.get());
+
+    vector<long> sizes;
+    for (auto& array : layout.arrays) sizes.push_back(kernel_array_size(array));
+    src = kernel_prelude() + driver_header;
+    src += "#define GPT_NB_ARRAYS " + to_string(layout.arrays.size()) + "\n";
+    src += "static const long gpt_params[] = " + c_array(params) + ";\n";
+    src += "static const long gpt_shape[] = " + c_array(kernel_shape(layout)) +
+           ";\n";
+    src += "static const long gpt_sizes[] = " + c_array(sizes) + ";\n\n";
+    src += kernel_source(scop, layout, original, "gpt_original") + "\n";
+    src += kernel_source(transformed.get(), layout, code, "gpt_transformed") +
+           "\n";
+    src += kernel_source(scop, layout, count_code(scop), "gpt_iterations");
+    src += "\n";
+    src += driver_main;
+    return true;
+}
+
+// build and run the driver in dir, fill the four numbers it prints
+static bool run_driver(const string& dir, const string& src,
+                       const BenchOptions& opt, double result[4]) {
+    string source = dir + "/driver.c", driver = dir + "/driver";
+    if (!write_file(source, src)) {
+        cerr << "bench: cannot write " << source << endl;
+        return false;
+    }
+    vector<string> build = split_words(opt.cc);
+    for (auto& flag : split_words(opt.cflags)) build.push_back(flag);
+    for (auto& arg : {string("-o"), driver, source, string("-lm")})
+        build.push_back(arg);
+    if (!run_program(build)) {
+        cerr << "bench: cannot compile " << source << endl;
+        return false;
+    }
+    string out;
+    if (!run_program({driver, to_string(opt.reps)}, &out)) return false;
+    return sscanf(out.c_str(), "%lf %lf %lf %lf", &result[0], &result[1],
+                  &result[2], &result[3]) == 4;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-r reps] [--cc compiler] [--cflags flags] [--keep] "
+            "file.c [N=value ...]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    char* input_name = NULL;
+    for (int i = 1; i < argc; ++i) {
+        const char* eq = strchr(argv[i], '=');
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            opt.reps = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--cc") == 0 && i + 1 < argc)
+            opt.cc = argv[++i];
+        else if (strcmp(argv[i], "--cflags") == 0 && i + 1 < argc)
+            opt.cflags = argv[++i];
+        else if (strcmp(argv[i], "--keep") == 0)
+            opt.keep = true;
+        else if (eq != NULL && eq != argv[i])
+            opt.params[string(argv[i], eq - argv[i])] = atol(eq + 1);
+        else if (input_name == NULL && argv[i][0] != '-')
+            input_name = argv[i];
+        else
+            usage(argv[0]);
+    }
+    if (input_name == NULL) usage(argv[0]);
+
+    ifstream in(input_name);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", input_name);
+        return 1;
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string source = buffer.str();
+
+    auto regions = find_scop_regions(source);
+    OwnedScop owned(read_scop_from_string(source, input_name));
+    osl_scop_p scop = owned.get();
+    int nb_scops = 0;
+    for (auto s = scop; s != NULL; s = s->next) ++nb_scops;
+    if (regions.empty() || nb_scops != (int)regions.size()) {
+        fprintf(stderr, "%s: %d scop regions but %d scops extracted\n",
+                input_name, (int)regions.size(), nb_scops);
+        return 1;
+    }
+
+    char dir_template[] = "/tmp/gpt-bench-XXXXXX";
+    if (mkdtemp(dir_template) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    string dir = dir_template;
+
+    int failed = 0;
+    auto s = scop;
+    for (size_t i = 0; i < regions.size(); ++i, s = s->next) {
+        auto& region = regions[i];
+        string original =
+            source.substr(region.body, region.body_end - region.body);
+        string scop_dir = dir + "/scop" + to_string(i + 1);
+        mkdir(scop_dir.c_str(), 0755);
+
+        string src;
+        double result[4];
+        printf("scop %d: ", (int)i + 1);
+        if (!driver_source(s, original, opt, src) ||
+            !run_driver(scop_dir, src, opt, result)) {
+            printf("failed\n");
+            ++failed;
+            continue;
+        }
+
+        double iterations = result[0], error = result[3];
+        bool match = error <= BENCH_TOLERANCE;
+        printf("%.0f iterations, ", iterations);
+        if (iterations > 0)
+            printf("%.2f -> %.2f cycles/iteration, ", result[1] / iterations,
+                   result[2] / iterations);
+        printf("speedup %.2fx, ", result[2] > 0 ? result[1] / result[2] : 0);
+        if (match)
+            printf("outputs match\n");
+        else
+            printf("outputs DIFFER (max relative error %g)\n", error);
+        if (!match) ++failed;
+    }
+
+    if (opt.keep)
+        printf("drivers kept in %s\n", dir.c_str());
+    else if (!remove_tree(dir))
+        fprintf(stderr, "cannot remove %s\n", dir.c_str());
+    return failed == 0 ? 0 : 1;
+}
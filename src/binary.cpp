@@ -0,0 +1,425 @@
+/* binary.cpp a compact binary serialization of osl_scop
+ *
+ * layout (all integers are LEB128 varints, signed ones zigzag encoded):
+ *   header    : "GPTSCOP\0", version
+ *   scop list : 1 scop ... 0
+ *   scop      : version, language, context, parameters, nb_statements,
+ *               statements, extensions
+ *   statement : domain, scattering, nb_accesses, accesses, extensions
+ *   relation  : nb_parts, then per part type, precision, nb_rows,
+ *               nb_columns, the four dimension counts, an encoding byte
+ *               and the entries (varints, or text for huge MP values)
+ *   generic   : nb_generics, then per generic URI and payload; scatnames,
+ *               strings and clay are stored as strings, every other
+ *               extension as its OpenScop text
+ */
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compact.h"
+#include "gpt.h"
+#include "raii.h"
+
+using namespace std;
+
+#define BINARY_MAGIC "GPTSCOP"
+#define BINARY_MAGIC_SIZE 8
+#define BINARY_VERSION 1
+
+// entries of a relation are varints, or text when some value is too wide
+#define ENCODING_VARINT 0
+#define ENCODING_TEXT 1
+
+class BinaryWriter {
+   public:
+    string buf;
+
+    void put_byte(unsigned char c) { buf.push_back(c); }
+
+    void put_uint(unsigned long long x) {
+        while (x >= 0x80) {
+            buf.push_back((unsigned char)(x | 0x80));
+            x >>= 7;
+        }
+        buf.push_back((unsigned char)x);
+    }
+
+    void put_int(long long x) {
+        put_uint(((unsigned long long)x << 1) ^ (unsigned long long)(x >> 63));
+    }
+
+    void put_string(const char* str) {
+        if (str == NULL) {
+            put_uint(0);
+            return;
+        }
+        size_t len = strlen(str);
+        put_uint(len + 1);
+        buf.append(str, len);
+    }
+};
+
+class BinaryReader {
+   public:
+    const unsigned char* p;
+    const unsigned char* end;
+    bool error = false;
+
+    BinaryReader(const string& data)
+        : p((const unsigned char*)data.data()),
+          end((const unsigned char*)data.data() + data.length()) {}
+
+    unsigned char get_byte() {
+        if (p >= end) {
+            error = true;
+            return 0;
+        }
+        return *p++;
+    }
+
+    unsigned long long get_uint() {
+        unsigned long long x = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            unsigned char c = get_byte();
+            x |= (unsigned long long)(c & 0x7f) << shift;
+            if (!(c & 0x80)) return x;
+        }
+        error = true;
+        return 0;
+    }
+
+    long long get_int() {
+        unsigned long long x = get_uint();
+        return (long long)(x >> 1) ^ -(long long)(x & 1);
+    }
+
+    // return a malloc'ed copy, NULL for a NULL string
+    char* get_string() {
+        unsigned long long len = get_uint();
+        if (len == 0) return NULL;
+        if (len - 1 > (unsigned long long)(end - p)) {
+            error = true;
+            return NULL;
+        }
+        char* str = (char*)malloc(len);
+        memcpy(str, p, len - 1);
+        str[len - 1] = '\0';
+        p += len - 1;
+        return str;
+    }
+};
+
+static void write_relation(BinaryWriter& w, osl_relation_p relation) {
+    int nb_parts = 0;
+    for (auto r = relation; r != NULL; r = r->next) ++nb_parts;
+    w.put_uint(nb_parts);
+
+    for (auto r = relation; r != NULL; r = r->next) {
+        w.put_int(r->type);
+        w.put_int(r->precision);
+        w.put_uint(r->nb_rows);
+        w.put_uint(r->nb_columns);
+        w.put_int(r->nb_output_dims);
+        w.put_int(r->nb_input_dims);
+        w.put_int(r->nb_local_dims);
+        w.put_int(r->nb_parameters);
+
+        bool narrow = true;
+        for (int i = 0; i < r->nb_rows && narrow; ++i)
+            for (int j = 0; j < r->nb_columns && narrow; ++j)
+                narrow = osl_int_fits(r->precision, r->m[i][j]);
+
+        w.put_byte(narrow ? ENCODING_VARINT : ENCODING_TEXT);
+        char buffer[1024];
+        for (int i = 0; i < r->nb_rows; ++i)
+            for (int j = 0; j < r->nb_columns; ++j) {
+                if (narrow) {
+                    w.put_int(osl_int_get_si(r->precision, r->m[i][j]));
+                } else {
+                    osl_int_sprint(buffer, r->precision, r->m[i][j]);
+                    w.put_string(buffer);
+                }
+            }
+    }
+}
+
+// whether the header of a relation part read from a file is consistent:
+// every entry takes one byte at least, so the matrix cannot be larger
+// than what is left of the file
+static bool valid_part(BinaryReader& r, long long type, long long precision,
+                       unsigned long long nb_rows,
+                       unsigned long long nb_columns,
+                       const vector<long long>& dims, int encoding) {
+    if (type != OSL_UNDEFINED && type != OSL_TYPE_CONTEXT &&
+        type != OSL_TYPE_DOMAIN && type != OSL_TYPE_SCATTERING &&
+        type != OSL_TYPE_ACCESS && type != OSL_TYPE_READ &&
+        type != OSL_TYPE_WRITE && type != OSL_TYPE_MAY_WRITE)
+        return false;
+    if (precision != OSL_PRECISION_SP && precision != OSL_PRECISION_DP &&
+        precision != OSL_PRECISION_MP)
+        return false;
+    if (encoding != ENCODING_VARINT && encoding != ENCODING_TEXT)
+        return false;
+    if (nb_rows > INT_MAX || nb_columns > INT_MAX) return false;
+    if (nb_columns != 0 &&
+        nb_rows > (unsigned long long)(r.end - r.p) / nb_columns)
+        return false;
+    long long sum = 2;
+    for (auto d : dims) {
+        if (d < 0 || d > INT_MAX) return false;
+        sum += d;
+    }
+    return (unsigned long long)sum == nb_columns;
+}
+
+static osl_relation_p read_relation(BinaryReader& r) {
+    osl_relation_p head = NULL;
+    osl_relation_p* tail = &head;
+    unsigned long long nb_parts = r.get_uint();
+
+    for (unsigned long long k = 0; k < nb_parts && !r.error; ++k) {
+        long long type = r.get_int();
+        long long precision = r.get_int();
+        unsigned long long nb_rows = r.get_uint();
+        unsigned long long nb_columns = r.get_uint();
+        long long nb_output_dims = r.get_int();
+        long long nb_input_dims = r.get_int();
+        long long nb_local_dims = r.get_int();
+        long long nb_parameters = r.get_int();
+        int encoding = r.get_byte();
+        if (r.error || !valid_part(r, type, precision, nb_rows, nb_columns,
+                                   {nb_output_dims, nb_input_dims,
+                                    nb_local_dims, nb_parameters},
+                                   encoding)) {
+            r.error = true;
+            break;
+        }
+
+        osl_relation_p relation =
+            osl_relation_pmalloc(precision, nb_rows, nb_columns);
+        osl_relation_set_type(relation, type);
+        osl_relation_set_attributes(relation, nb_output_dims, nb_input_dims,
+                                    nb_local_dims, nb_parameters);
+        *tail = relation;
+        tail = &relation->next;
+
+        for (int i = 0; i < nb_rows; ++i)
+            for (int j = 0; j < nb_columns; ++j) {
+                if (encoding == ENCODING_VARINT) {
+                    // the writer only uses varints when every entry fits
+                    long long value = r.get_int();
+                    if (value < INT_MIN || value > INT_MAX) {
+                        r.error = true;
+                        continue;
+                    }
+                    osl_int_set_si(precision, &relation->m[i][j], (int)value);
+                } else {
+                    OwnedString str(r.get_string());
+                    if (!str) {
+                        r.error = true;
+                        continue;
+                    }
+                    char* ptr = str.get();
+                    osl_int_sread(&ptr, precision, &relation->m[i][j]);
+                }
+            }
+    }
+    return head;
+}
+
+static void write_strings(BinaryWriter& w, osl_strings_p strings) {
+    size_t size = strings == NULL ? 0 : osl_strings_size(strings);
+    w.put_uint(size);
+    for (size_t i = 0; i < size; ++i) w.put_string(strings->string[i]);
+}
+
+static osl_strings_p read_strings(BinaryReader& r) {
+    osl_strings_p strings = osl_strings_malloc();
+    unsigned long long size = r.get_uint();
+    for (unsigned long long i = 0; i < size && !r.error; ++i) {
+        OwnedString str(r.get_string());
+        osl_strings_add(strings, !str ? "" : str.get());
+    }
+    return strings;
+}
+
+static void write_generic(BinaryWriter& w, osl_generic_p generic) {
+    int nb_generics = 0;
+    for (auto g = generic; g != NULL; g = g->next) ++nb_generics;
+    w.put_uint(nb_generics);
+
+    for (auto g = generic; g != NULL; g = g->next) {
+        const char* uri = g->interface->URI;
+        w.put_string(uri);
+        if (strcmp(uri, OSL_URI_SCATNAMES) == 0) {
+            write_strings(w, ((osl_scatnames_p)g->data)->names);
+        } else if (strcmp(uri, OSL_URI_STRINGS) == 0) {
+            write_strings(w, (osl_strings_p)g->data);
+        } else if (strcmp(uri, OSL_URI_CLAY) == 0) {
+            w.put_string(((osl_clay_p)g->data)->script);
+        } else {
+            char* text = g->interface->sprint(g->data);
+            w.put_string(text);
+            free(text);
+        }
+    }
+}
+
+static osl_generic_p read_generic(BinaryReader& r) {
+    osl_generic_p head = NULL;
+    osl_interface_p registry = NULL;
+    unsigned long long nb_generics = r.get_uint();
+
+    for (unsigned long long k = 0; k < nb_generics && !r.error; ++k) {
+        OwnedString owned_uri(r.get_string());
+        char* uri = owned_uri.get();
+        if (uri == NULL) {
+            r.error = true;
+            break;
+        }
+        osl_generic_p generic = NULL;
+        if (strcmp(uri, OSL_URI_SCATNAMES) == 0) {
+            osl_scatnames_p scatnames = osl_scatnames_malloc();
+            scatnames->names = read_strings(r);
+            generic = osl_generic_shell(scatnames, osl_scatnames_interface());
+        } else if (strcmp(uri, OSL_URI_STRINGS) == 0) {
+            generic = osl_generic_shell(read_strings(r),
+                                        osl_strings_interface());
+        } else if (strcmp(uri, OSL_URI_CLAY) == 0) {
+            osl_clay_p clay = osl_clay_malloc();
+            clay->script = r.get_string();
+            generic = osl_generic_shell(clay, osl_clay_interface());
+        } else {
+            OwnedString text(r.get_string());
+            if (registry == NULL)
+                registry = osl_interface_get_default_registry();
+            osl_interface_p interface = osl_interface_lookup(registry, uri);
+            if (text && interface != NULL) {
+                char* ptr = text.get();
+                generic = osl_generic_shell(interface->sread(&ptr),
+                                            osl_interface_nclone(interface, 1));
+            } else {
+                cerr << "binary scop: unknown extension " << uri << endl;
+            }
+        }
+        if (generic != NULL) osl_generic_add(&head, generic);
+    }
+    if (registry != NULL) osl_interface_free(registry);
+    return head;
+}
+
+static void write_statement(BinaryWriter& w, osl_statement_p statement) {
+    write_relation(w, statement->domain);
+    write_relation(w, statement->scattering);
+    int nb_accesses = 0;
+    for (auto l = statement->access; l != NULL; l = l->next) ++nb_accesses;
+    w.put_uint(nb_accesses);
+    for (auto l = statement->access; l != NULL; l = l->next)
+        write_relation(w, l->elt);
+    write_generic(w, statement->extension);
+}
+
+static osl_statement_p read_statement(BinaryReader& r) {
+    osl_statement_p statement = osl_statement_malloc();
+    statement->domain = read_relation(r);
+    statement->scattering = read_relation(r);
+    unsigned long long nb_accesses = r.get_uint();
+    osl_relation_list_p* tail = &statement->access;
+    for (unsigned long long k = 0; k < nb_accesses && !r.error; ++k) {
+        *tail = osl_relation_list_malloc();
+        (*tail)->elt = read_relation(r);
+        tail = &(*tail)->next;
+    }
+    statement->extension = read_generic(r);
+    return statement;
+}
+
+int write_scop_binary(FILE* output, osl_scop_p scop) {
+    BinaryWriter w;
+    w.buf.append(BINARY_MAGIC, BINARY_MAGIC_SIZE);
+    w.put_uint(BINARY_VERSION);
+
+    for (; scop != NULL; scop = scop->next) {
+        w.put_byte(1);
+        w.put_int(scop->version);
+        w.put_string(scop->language);
+        write_relation(w, scop->context);
+        write_generic(w, scop->parameters);
+        w.put_uint(osl_statement_number(scop->statement));
+        for (auto s = scop->statement; s != NULL; s = s->next)
+            write_statement(w, s);
+        write_generic(w, scop->extension);
+    }
+    w.put_byte(0);
+
+    if (fwrite(w.buf.data(), 1, w.buf.length(), output) != w.buf.length())
+        return -1;
+    return 0;
+}
+
+osl_scop_p read_scop_binary(FILE* input) {
+    string data;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), input)) > 0)
+        data.append(chunk, n);
+
+    if (data.length() < BINARY_MAGIC_SIZE ||
+        memcmp(data.data(), BINARY_MAGIC, BINARY_MAGIC_SIZE) != 0) {
+        cerr << "binary scop: bad magic" << endl;
+        return NULL;
+    }
+    BinaryReader r(data);
+    r.p += BINARY_MAGIC_SIZE;
+    unsigned long long version = r.get_uint();
+    if (version != BINARY_VERSION) {
+        cerr << "binary scop: unsupported version " << version << endl;
+        return NULL;
+    }
+
+    OwnedScop head;
+    osl_scop_p* tail = NULL;
+    while (!r.error && r.get_byte() == 1) {
+        osl_scop_p scop = osl_scop_malloc();
+        if (tail == NULL)
+            head.reset(scop);
+        else
+            *tail = scop;
+        tail = &scop->next;
+        scop->version = r.get_int();
+        scop->language = r.get_string();
+        scop->context = read_relation(r);
+        scop->parameters = read_generic(r);
+        unsigned long long nb_statements = r.get_uint();
+        osl_statement_p* stail = &scop->statement;
+        for (unsigned long long k = 0; k < nb_statements && !r.error; ++k) {
+            *stail = read_statement(r);
+            stail = &(*stail)->next;
+        }
+        scop->extension = read_generic(r);
+    }
+
+    if (r.error) {
+        cerr << "binary scop: truncated or corrupted input" << endl;
+        return NULL;
+    }
+    return head.release();
+}
+
+bool is_scop_binary(FILE* input) {
+    char magic[BINARY_MAGIC_SIZE];
+    long pos = ftell(input);
+    size_t n = fread(magic, 1, BINARY_MAGIC_SIZE, input);
+    fseek(input, pos, SEEK_SET);
+    return n == BINARY_MAGIC_SIZE &&
+           memcmp(magic, BINARY_MAGIC, BINARY_MAGIC_SIZE) == 0;
+}
+
+osl_scop_p read_scop_from_file(FILE* input) {
+    if (is_scop_binary(input)) return read_scop_binary(input);
+    return osl_scop_read(input);
+}
@@ -0,0 +1,331 @@
+/* cache_model.cpp static estimate of the cache misses of a schedule
+ *
+ * every loop of the scattering is turned into a step on the original
+ * iterators, and every access into a stride (in array elements) per loop.
+ * For the statements of one loop nest, the footprint of the innermost loops
+ * is the number of distinct cache lines they touch; the outermost loops
+ * whose footprint fits in the cache reuse it, everything above reloads it.
+ * The cache is taken as fully associative with LRU replacement.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "affine.h"
+#include "gpt.h"
+#include "raii.h"
+
+using namespace std;
+
+#define MODEL_EPS 1e-9
+
+// a loop of the schedule of one statement
+struct LoopModel {
+    double trip;            // number of iterations
+    vector<double> delta;   // change of the iterators per iteration
+};
+
+// invert a square matrix in place, return false if it is singular
+static bool invert(vector<vector<double>>& m) {
+    int n = m.size();
+    vector<vector<double>> inv(n, vector<double>(n, 0));
+    for (int i = 0; i < n; ++i) inv[i][i] = 1;
+    for (int c = 0; c < n; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < n; ++r)
+            if (fabs(m[r][c]) > fabs(m[pivot][c])) pivot = r;
+        if (fabs(m[pivot][c]) < MODEL_EPS) return false;
+        swap(m[c], m[pivot]);
+        swap(inv[c], inv[pivot]);
+        double p = m[c][c];
+        for (int k = 0; k < n; ++k) {
+            m[c][k] /= p;
+            inv[c][k] /= p;
+        }
+        for (int r = 0; r < n; ++r) {
+            if (r == c || m[r][c] == 0) continue;
+            double f = m[r][c];
+            for (int k = 0; k < n; ++k) {
+                m[r][k] -= f * m[c][k];
+                inv[r][k] -= f * inv[c][k];
+            }
+        }
+    }
+    m = inv;
+    return true;
+}
+
+// the loops of a statement, outermost first, over the box [lo, hi] of its
+// iterators; a loop dimension is either an affine function of the iterators
+// (equalities of the scattering) or a tile of another one (stripmine())
+static bool statement_loops(osl_statement_p statement,
+                            const vector<long long>& lo,
+                            const vector<long long>& hi,
+                            vector<LoopModel>& loops) {
+    auto scattering = statement->scattering;
+    int out = scattering->nb_output_dims;
+    int in = scattering->nb_input_dims;
+
+    // E_out * c + E_in * i + ... = 0
+    vector<vector<double>> e_out, e_in;
+    vector<bool> defined(out, false);
+    for (int row = 0; row < scattering->nb_rows; ++row) {
+        if (entry(scattering, row, 0) != 0) continue;
+        vector<double> o(out), i(in);
+        for (int k = 0; k < out; ++k) {
+            o[k] = entry(scattering, row, 1 + k);
+            if (o[k] != 0) defined[k] = true;
+        }
+        for (int k = 0; k < in; ++k) i[k] = entry(scattering, row, 1 + out + k);
+        e_out.push_back(o);
+        e_in.push_back(i);
+    }
+
+    // solve c = -E_out^-1 * E_in * i on the defined dimensions
+    vector<int> dims;
+    for (int k = 0; k < out; ++k)
+        if (defined[k]) dims.push_back(k);
+    if (dims.size() != e_out.size()) return false;
+    vector<vector<double>> sub(dims.size(), vector<double>(dims.size()));
+    for (size_t r = 0; r < dims.size(); ++r)
+        for (size_t c = 0; c < dims.size(); ++c) sub[r][c] = e_out[r][dims[c]];
+    if (!invert(sub)) return false;
+    vector<vector<double>> coeff(out, vector<double>(in, 0));
+    for (size_t r = 0; r < dims.size(); ++r)
+        for (int k = 0; k < in; ++k)
+            for (size_t c = 0; c < dims.size(); ++c)
+                coeff[dims[r]][k] -= sub[r][c] * e_in[c][k];
+
+    // tile dimensions: T * t <= p <= T * t + T - 1 on another dimension p
+    vector<int> tile_of(out, -1), tile_size(out, 1);
+    for (int k = 0; k < out; ++k) {
+        if (defined[k]) continue;
+        for (int row = 0; row < scattering->nb_rows; ++row) {
+            long long t = entry(scattering, row, 1 + k);
+            if (entry(scattering, row, 0) == 0 || t == 0) continue;
+            for (int p = 0; p < out; ++p)
+                if (p != k && entry(scattering, row, 1 + p) != 0) {
+                    tile_of[k] = p;
+                    tile_size[k] = llabs(t);
+                }
+        }
+    }
+
+    // the steps of the affine loops come from the inverse of their matrix
+    vector<int> affine_loops;
+    for (int k = 1; k < out; k += 2)
+        if (defined[k]) affine_loops.push_back(k);
+    vector<vector<double>> m(affine_loops.size());
+    for (size_t r = 0; r < affine_loops.size(); ++r)
+        m[r] = coeff[affine_loops[r]];
+    bool square = (int)affine_loops.size() == in && invert(m);
+
+    vector<double> range(out, 1);
+    vector<vector<double>> delta(out, vector<double>(in, 0));
+    for (size_t r = 0; r < affine_loops.size(); ++r) {
+        int k = affine_loops[r];
+        double min_val = 0, max_val = 0;
+        for (int i = 0; i < in; ++i) {
+            min_val += min(coeff[k][i] * lo[i], coeff[k][i] * hi[i]);
+            max_val += max(coeff[k][i] * lo[i], coeff[k][i] * hi[i]);
+        }
+        range[k] = floor(max_val - min_val + MODEL_EPS) + 1;
+        for (int i = 0; i < in; ++i) {
+            if (square)
+                delta[k][i] = m[i][r];
+            else  // e.g. a dimension left on one iterator only
+                delta[k][i] = coeff[k][i];
+        }
+    }
+
+    loops.clear();
+    for (int k = 1; k < out; k += 2) {
+        LoopModel loop;
+        loop.trip = range[k];
+        loop.delta = delta[k];
+        int p = tile_of[k];
+        if (p >= 0) {
+            loop.trip = ceil(range[p] / tile_size[k]);
+            loop.delta = delta[p];
+            for (auto& d : loop.delta) d *= tile_size[k];
+        }
+        // a point loop inside its tile loop
+        for (int t = 1; t < k; t += 2)
+            if (tile_of[t] == k)
+                loop.trip = min(loop.trip, (double)tile_size[t]);
+        loops.push_back(loop);
+    }
+    return true;
+}
+
+// a group of references to one array moving the same way in a nest
+struct RefGroup {
+    int array;
+    vector<double> stride;  // in elements, per loop of the nest
+    double array_lines;     // lines of the whole array
+};
+
+// distinct lines touched by a group over the loops j.. of the nest
+static double group_lines(const RefGroup& g, const vector<LoopModel>& loops,
+                          int j, double line_elements) {
+    double lines = 1;
+    int spatial = -1;
+    for (int d = j; d < (int)loops.size(); ++d) {
+        double s = fabs(g.stride[d]);
+        if (s < MODEL_EPS) continue;
+        lines *= loops[d].trip;
+        if (s < line_elements &&
+            (spatial < 0 || s < fabs(g.stride[spatial])))
+            spatial = d;
+    }
+    // consecutive iterations of the smallest stride share their lines
+    if (spatial >= 0) {
+        double trip = loops[spatial].trip;
+        lines = lines / trip *
+                ceil(trip * fabs(g.stride[spatial]) / line_elements);
+    }
+    return min(lines, g.array_lines);
+}
+
+bool estimate_cache(osl_scop_p scop, const vector<long>& params,
+                    const CacheConfig& cache, CacheEstimate& estimate,
+                    bool verbose) {
+    estimate = CacheEstimate();
+    KernelLayout layout;
+    if (!kernel_layout(scop, params, layout)) return false;
+    double line_elements = max(1.0, (double)cache.line / cache.element);
+    double capacity = (double)cache.size / cache.line;
+
+    // the statements of one innermost loop body share a nest
+    map<vector<int>, vector<osl_statement_p>> nests;
+    for (auto s = scop->statement; s != NULL; s = s->next) {
+        auto id = get_statementID(s->scattering);
+        id.pop_back();
+        nests[id].push_back(s);
+    }
+
+    int nb_reuse = 0;
+    for (auto& nest : nests) {
+        vector<LoopModel> nest_loops;
+        vector<RefGroup> groups;
+        for (auto s : nest.second) {
+            vector<long long> lo, hi;
+            if (!domain_box(s->domain, params, lo, hi)) continue;
+            vector<LoopModel> loops;
+            if (!statement_loops(s, lo, hi, loops)) {
+                cerr << "cache model: cannot read the scattering" << endl;
+                return false;
+            }
+            if (nest_loops.empty()) nest_loops = loops;
+
+            double instances = 1;
+            for (size_t k = 0; k < lo.size(); ++k)
+                instances *= max(0LL, hi[k] - lo[k] + 1);
+
+            for (auto l = s->access; l != NULL; l = l->next) {
+                AccessFunction f;
+                if (!access_function(l->elt, f)) return false;
+                estimate.accesses += instances;
+                const KernelArray* array = NULL;
+                for (auto& a : layout.arrays)
+                    if (a.id == f.array) array = &a;
+                if (array == NULL) continue;
+
+                // row-major strides of the array
+                int rank = f.dims.size();
+                vector<double> element_stride(rank, 1);
+                for (int d = rank - 2; d >= 0; --d)
+                    element_stride[d] =
+                        element_stride[d + 1] * array->extent[d + 1];
+
+                RefGroup g;
+                g.array = f.array;
+                g.array_lines =
+                    ceil(kernel_array_size(*array) / line_elements);
+                for (auto& loop : loops) {
+                    double s = 0;
+                    for (int d = 0; d < rank; ++d)
+                        for (size_t k = 0; k < loop.delta.size(); ++k)
+                            s += element_stride[d] * f.dims[d][k] *
+                                 loop.delta[k];
+                    g.stride.push_back(s);
+                }
+                bool found = false;
+                for (auto& other : groups)
+                    found |= other.array == g.array && other.stride == g.stride;
+                if (!found) groups.push_back(g);
+            }
+        }
+        if (groups.empty()) continue;
+
+        // footprint[j] of the loops j.., in lines
+        int n = nest_loops.size();
+        vector<double> footprint(n + 1, 0);
+        for (int j = 0; j <= n; ++j)
+            for (auto& g : groups)
+                footprint[j] += group_lines(g, nest_loops, j, line_elements);
+
+        // the outermost loops that fit in the cache keep their lines
+        int fit = n;
+        while (fit > 0 && footprint[fit - 1] <= capacity) --fit;
+        double misses = footprint[fit];
+        for (int d = 0; d < fit; ++d) misses *= nest_loops[d].trip;
+        estimate.misses += misses;
+
+        // reuse distance: footprint inside the innermost loop with reuse
+        for (auto& g : groups) {
+            int carrier = -1;
+            for (int d = n - 1; d >= 0 && carrier < 0; --d)
+                if (fabs(g.stride[d]) < line_elements) carrier = d;
+            double distance =
+                carrier < 0 ? -1 : footprint[carrier + 1] * cache.line;
+            if (distance >= 0) {
+                estimate.reuse += distance;
+                ++nb_reuse;
+            }
+            if (verbose) {
+                cerr << "  " << array_name(scop, g.array) << " strides";
+                for (auto s : g.stride) cerr << " " << s;
+                if (distance < 0)
+                    cerr << ", no reuse" << endl;
+                else
+                    cerr << ", reuse distance " << distance << " bytes"
+                         << (distance <= cache.size ? "" : " (miss)") << endl;
+            }
+        }
+    }
+    if (nb_reuse > 0) estimate.reuse /= nb_reuse;
+    return true;
+}
+
+vector<int> rank_schedules(osl_scop_p scop, const vector<string>& scripts,
+                           const vector<long>& params,
+                           const CacheConfig& cache,
+                           vector<CacheEstimate>& estimates) {
+    estimates.assign(scripts.size(), CacheEstimate());
+    vector<bool> valid(scripts.size(), false);
+    // every script runs on the scop itself and is rolled back, only the
+    // statements it edits are copied
+    ScopTransaction transaction;
+    transaction_begin(scop, transaction);
+    for (size_t i = 0; i < scripts.size(); ++i) {
+        valid[i] = transaction_apply_script(transaction, scripts[i]) == 0 &&
+                   estimate_cache(scop, params, cache, estimates[i]);
+        transaction_rollback(transaction);
+    }
+
+    // fewest misses first, the invalid candidates last
+    vector<int> order(scripts.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if (valid[a] != valid[b]) return (bool)valid[a];
+        return estimates[a].misses < estimates[b].misses;
+    });
+    for (size_t i = 0; i < scripts.size(); ++i)
+        if (!valid[i]) estimates[i].misses = -1;
+    return order;
+}
@@ -6,45 +6,54 @@ read scop from file and print to c code
 #include <cloog/cloog.h>
 #include <osl/osl.h>
 
-using namespace std;
+#include "gpt.h"
+#include "raii.h"
 
-void print_scop_to_c(FILE* output, osl_scop_p scop) {
-    CloogState* state;
-    CloogOptions* options;
-    CloogInput* input;
-    struct clast_stmt* clast;
-    state = cloog_state_malloc();
-    options = cloog_options_malloc(state);
-    options->openscop = 1;
-    cloog_options_copy_from_osl_scop(scop, options);
-    input = cloog_input_from_osl_scop(options->state, scop);
-    clast = cloog_clast_create_from_input(input, options);
-    clast_pprint(output, clast, 0, options);
-    cloog_clast_free(clast);
-    options->scop = NULL;  // don’t free the scop
-    cloog_options_free(options);
-    cloog_state_free(state);  // the input is freed inside
-}
+using namespace std;
 
 int main(int argc, char* argv[]) {
-    FILE *scop_src, *target;
+    OwnedFile scop_src, target;
+
+    // convert a textual scop into the binary format
+    if (argc == 4 && strcmp(argv[1], "--to-binary") == 0) {
+        scop_src.reset(fopen(argv[2], "r"));
+        target.reset(fopen(argv[3], "wb"));
+        if (!scop_src || !target) {
+            cout << "cannot open " << argv[2] << " or " << argv[3] << endl;
+            return 1;
+        }
+        OwnedScop scop(read_scop_from_file(scop_src.get()));
+        return !scop ? 1 : write_scop_binary(target.get(), scop.get());
+    }
 
-    if (argc == 1)
-        scop_src = fopen("scop.txt", "r");
-    else if (argc == 2) {
-        scop_src = fopen(argv[1], "r");
-        target = fopen("target.c", "w");
+    if (argc == 1) {
+        scop_src.reset(fopen("scop.txt", "r"));
+        target.reset(fopen("target.c", "w"));
+    } else if (argc == 2) {
+        scop_src.reset(fopen(argv[1], "r"));
+        target.reset(fopen("target.c", "w"));
     } else if (argc == 3) {
-        scop_src = fopen(argv[1], "r");
-        target = fopen(argv[2], "w");
+        scop_src.reset(fopen(argv[1], "r"));
+        target.reset(fopen(argv[2], "w"));
     } else {
         cout << "Usage: ./codegen <scop_src> <target>" << endl;
+        cout << "       ./codegen --to-binary <scop_src> <target.bscop>"
+             << endl;
+        return 1;
+    }
+    if (!scop_src || !target) {
+        cout << "cannot open the input or the output file" << endl;
         return 1;
     }
 
-    osl_scop_p scop = osl_scop_read(scop_src);
+    // textual or binary OpenScop
+    OwnedScop scop(read_scop_from_file(scop_src.get()));
+    if (!scop) {
+        cout << "cannot read a scop" << endl;
+        return 1;
+    }
 
-    print_scop_to_c(target, scop);
+    print_scop_to_c(target.get(), scop.get());
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,127 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <climits>
+#include <vector>
+
+using namespace std;
+
+// osl integers read as native ints, the round trip check goes through one
+// scratch integer instead of allocating one (a GMP number) per entry
+class NativeReader {
+   public:
+    explicit NativeReader(int precision) : precision(precision) {
+        osl_int_init(precision, &t);
+    }
+    NativeReader(const NativeReader&) = delete;
+    NativeReader& operator=(const NativeReader&) = delete;
+    ~NativeReader() { osl_int_clear(precision, &t); }
+
+    // false if value does not fit a native int
+    bool read(osl_const_int_t value, long long& v) {
+        long l = osl_int_get_si(precision, value);
+        if (l < INT_MIN || l > INT_MAX) return false;
+        osl_int_set_si(precision, &t, (int)l);
+        if (!osl_int_eq(precision, t, value)) return false;
+        v = l;
+        return true;
+    }
+
+   private:
+    int precision;
+    osl_int_t t;
+};
+
+// whether an osl integer survives a round trip through a native int
+inline bool osl_int_fits(int precision, osl_const_int_t value) {
+    long long v;
+    return NativeReader(precision).read(value, v);
+}
+
+// one relation part packed row after row into native integers
+// osl_relation holds one osl_int_t per entry (a GMP number in MP
+// precision) and reallocates the whole matrix for every row or column it
+// inserts: stripmine() does its edits here, between one load() and one
+// store(), when every entry fits a native int
+class CompactRelation {
+   public:
+    int type = 0, precision = 0;
+    int nb_output_dims = 0, nb_input_dims = 0, nb_local_dims = 0,
+        nb_parameters = 0;
+    int nb_rows = 0, nb_columns = 0;
+    vector<long long> m;
+
+    long long& at(int row, int col) {
+        return m[(size_t)row * nb_columns + col];
+    }
+
+    // false if an entry of part does not fit a native int
+    bool load(osl_relation_p part) {
+        type = part->type;
+        precision = part->precision;
+        nb_output_dims = part->nb_output_dims;
+        nb_input_dims = part->nb_input_dims;
+        nb_local_dims = part->nb_local_dims;
+        nb_parameters = part->nb_parameters;
+        nb_rows = part->nb_rows;
+        nb_columns = part->nb_columns;
+        m.assign((size_t)nb_rows * nb_columns, 0);
+        NativeReader reader(precision);
+        for (int row = 0; row < nb_rows; ++row)
+            for (int col = 0; col < nb_columns; ++col)
+                if (!reader.read(part->m[row][col], at(row, col)))
+                    return false;
+        return true;
+    }
+
+    // replace the part *link with a new one holding the packed matrix,
+    // every entry must fit a native int (the caller checks what it adds to
+    // the entries load() accepted)
+    void store(osl_relation_p* link) {
+        osl_relation_p part = osl_relation_pmalloc(precision, nb_rows,
+                                                   nb_columns);
+        osl_relation_set_type(part, type);
+        osl_relation_set_attributes(part, nb_output_dims, nb_input_dims,
+                                    nb_local_dims, nb_parameters);
+        for (int row = 0; row < nb_rows; ++row)
+            for (int col = 0; col < nb_columns; ++col)
+                if (at(row, col) != 0)
+                    osl_int_set_si(precision, &part->m[row][col],
+                                   (int)at(row, col));
+        part->next = (*link)->next;
+        (*link)->next = NULL;
+        osl_relation_free(*link);
+        *link = part;
+    }
+
+    // n zero columns before column col
+    void insert_columns(int col, int n) {
+        vector<long long> wider((size_t)nb_rows * (nb_columns + n), 0);
+        for (int row = 0; row < nb_rows; ++row)
+            for (int c = 0; c < nb_columns; ++c)
+                wider[(size_t)row * (nb_columns + n) + c + (c >= col ? n : 0)] =
+                    at(row, c);
+        m.swap(wider);
+        nb_columns += n;
+    }
+
+    // n zero rows before row
+    void insert_rows(int row, int n) {
+        m.insert(m.begin() + (size_t)row * nb_columns, (size_t)n * nb_columns,
+                 0);
+        nb_rows += n;
+    }
+
+    // the first row using output dimension k, as find_row()
+    int find_row(int k) {
+        for (int row = 0; row < nb_rows; ++row)
+            if (at(row, k + 1) != 0) return row;
+        return -1;
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "utility.h"
+
+using namespace std;
+
+#define STEP_INTERCHANGE 0
+#define STEP_SKEW 1
+#define STEP_REVERSE 2
+
+// a run of unimodular steps (interchange, skew, reversal) on the loop
+// columns of the scattering, recorded first and then folded into one
+// transformation matrix per statement
+// the steps only touch odd (loop) columns, so the statementIDs (even
+// columns) used to match the statements do not change along the run
+class UnimodularChain {
+   public:
+    struct Step {
+        vector<int> loop_id;
+        int type;
+        int idx1, idx2;  // output dimensions, as in interchange()
+        int coeff;
+    };
+    vector<Step> steps;
+
+    bool empty() { return steps.empty(); }
+
+    void add_interchange(osl_scop_p scop, vector<int> loop_id,
+                         unsigned int depth_1, unsigned int depth_2,
+                         int pretty) {
+        if (depth_1 == depth_2) return;
+        int idx1 = depth_1 * 2 - 1;
+        int idx2 = depth_2 * 2 - 1;
+        steps.push_back({loop_id, STEP_INTERCHANGE, idx1, idx2, 0});
+        // the names are global, swap them right away
+        if (pretty) {
+            osl_strings_p names = ((osl_scatnames_p)osl_generic_lookup(
+                                       scop->extension, OSL_URI_SCATNAMES))
+                                      ->names;
+            swap(names->string[idx1], names->string[idx2]);
+        }
+    }
+
+    // same column update as skew(): column depth_other += coeff * depth
+    void add_skew(vector<int> loop_id, unsigned int depth,
+                  unsigned int depth_other, int coeff) {
+        steps.push_back({loop_id, STEP_SKEW, (int)depth * 2 - 1,
+                         (int)depth_other * 2 - 1, coeff});
+    }
+
+    void add_reverse(vector<int> loop_id, unsigned int depth) {
+        steps.push_back({loop_id, STEP_REVERSE, (int)depth * 2 - 1, 0, -1});
+    }
+
+    // apply all the recorded steps, each scattering is rewritten once
+    void apply(osl_scop_p scop) {
+        if (steps.empty()) return;
+        for (auto statement = scop->statement; statement != NULL;
+             statement = statement->next)
+            apply_statement(statement);
+        steps.clear();
+    }
+
+   private:
+    void apply_statement(osl_statement_p statement) {
+        auto scattering = statement->scattering;
+        int dims = scattering->nb_output_dims;
+        auto id = get_statementID(scattering);
+
+        // compose the matching steps on an identity matrix, as long as
+        // every coefficient stays an int
+        vector<vector<long long>> u(dims, vector<long long>(dims, 0));
+        for (int i = 0; i < dims; ++i) u[i][i] = 1;
+        vector<int> touched;
+        bool fits = true;
+        for (auto& step : steps) {
+            if (!in_loop(step.loop_id, id) || step.idx1 >= dims ||
+                step.idx2 >= dims)
+                continue;
+            for (int i = 0; i < dims && fits; ++i) {
+                if (step.type == STEP_INTERCHANGE)
+                    swap(u[i][step.idx1], u[i][step.idx2]);
+                else if (step.type == STEP_SKEW)
+                    u[i][step.idx2] += step.coeff * u[i][step.idx1];
+                else
+                    u[i][step.idx1] = -u[i][step.idx1];
+                fits = u[i][step.idx2] >= INT_MIN &&
+                       u[i][step.idx2] <= INT_MAX;
+            }
+            touched.push_back(step.idx1);
+            if (step.type != STEP_REVERSE) touched.push_back(step.idx2);
+        }
+        if (touched.empty()) return;
+        if (!fits) {
+            apply_steps(statement, id);
+            return;
+        }
+        sort(touched.begin(), touched.end());
+        touched.erase(unique(touched.begin(), touched.end()), touched.end());
+
+        // row = row * U, restricted to the touched columns
+        int n = touched.size();
+        int precision = scattering->precision;
+        vector<osl_int_t> value(n);
+        osl_int_t t;
+        osl_int_init(precision, &t);
+        for (auto& v : value) osl_int_init(precision, &v);
+        for (int row = 0; row < scattering->nb_rows; ++row) {
+            auto m = scattering->m[row];
+            for (int j = 0; j < n; ++j) {
+                osl_int_set_si(precision, &value[j], 0);
+                for (int k = 0; k < n; ++k) {
+                    long long coeff = u[touched[k]][touched[j]];
+                    if (coeff == 0) continue;
+                    osl_int_mul_si(precision, &t, m[touched[k] + 1],
+                                   (int)coeff);
+                    osl_int_add(precision, &value[j], value[j], t);
+                }
+            }
+            for (int j = 0; j < n; ++j)
+                osl_int_assign(precision, &m[touched[j] + 1], value[j]);
+        }
+        for (auto& v : value) osl_int_clear(precision, &v);
+        osl_int_clear(precision, &t);
+    }
+
+    // the composed matrix leaves the int range of osl_int_mul_si: run the
+    // steps one by one, their own coefficients are ints
+    void apply_steps(osl_statement_p statement, const vector<int>& id) {
+        auto scattering = statement->scattering;
+        int precision = scattering->precision;
+        int dims = scattering->nb_output_dims;
+        osl_int_t t;
+        osl_int_init(precision, &t);
+        for (auto& step : steps) {
+            if (!in_loop(step.loop_id, id) || step.idx1 >= dims ||
+                step.idx2 >= dims)
+                continue;
+            for (int row = 0; row < scattering->nb_rows; ++row) {
+                auto m = scattering->m[row];
+                auto& a = m[step.idx1 + 1];
+                auto& b = m[step.idx2 + 1];
+                if (step.type == STEP_INTERCHANGE) {
+                    swap(a, b);
+                } else if (step.type == STEP_SKEW) {
+                    osl_int_mul_si(precision, &t, a, step.coeff);
+                    osl_int_add(precision, &b, b, t);
+                } else {
+                    osl_int_oppose(precision, &a, a);
+                }
+            }
+        }
+        osl_int_clear(precision, &t);
+    }
+};
+
+#endif
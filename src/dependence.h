@@ -0,0 +1,234 @@
+#ifndef DEPENDENCE_H
+#define DEPENDENCE_H
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "affine.h"
+#include "utility.h"
+
+using namespace std;
+
+// unknown component of a distance vector
+#define DIST_ANY LLONG_MIN
+
+// a dependence from an instance of source to a later instance of sink,
+// distance[d] is the difference of their (d + 1)-th loop counters
+struct Dependence {
+    osl_statement_p source, sink;
+    vector<long long> distance;
+};
+
+// read the loop dimension at depth as iterator = sign * c + offset
+// return false if the dimension is not a plain (shifted) iterator
+inline bool loop_iterator(osl_relation_p scattering, int depth, int& iter,
+                          int& sign, long long& offset) {
+    int out = scattering->nb_output_dims;
+    int in = scattering->nb_input_dims;
+    int col = depth * 2 - 1;
+    if (col >= out) return false;
+    int row = find_row(scattering, col);
+    if (row < 0 || entry(scattering, row, 0) != 0) return false;
+    for (int k = 0; k < out; ++k)
+        if (k != col && entry(scattering, row, 1 + k) != 0) return false;
+    for (int c = 1 + out + in; c < scattering->nb_columns - 1; ++c)
+        if (entry(scattering, row, c) != 0) return false;
+
+    // a * c + b * i + k0 = 0  =>  i = -a * b * c - b * k0
+    long long a = entry(scattering, row, 1 + col);
+    iter = -1;
+    for (int k = 0; k < in; ++k) {
+        long long b = entry(scattering, row, 1 + out + k);
+        if (b == 0) continue;
+        if (iter >= 0 || (b != 1 && b != -1) || (a != 1 && a != -1))
+            return false;
+        iter = k;
+        sign = -a * b;
+        offset = -b * entry(scattering, row, scattering->nb_columns - 1);
+    }
+    return iter >= 0;
+}
+
+// number of loops two statements share
+inline int common_loops(osl_statement_p s, osl_statement_p t) {
+    auto id0 = get_statementID(s->scattering);
+    auto id1 = get_statementID(t->scattering);
+    int depth = 0;
+    while (depth + 1 < (int)id0.size() && depth + 1 < (int)id1.size() &&
+           id0[depth] == id1[depth])
+        ++depth;
+    return depth;
+}
+
+inline long long gcd_ll(long long a, long long b) {
+    a = llabs(a);
+    b = llabs(b);
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// an access subscript rewritten on the loop counters of its statement:
+// coefficients of the shared loops, whether other iterators or parameters
+// appear, and the constant
+struct LoopSubscript {
+    vector<long long> loop;
+    vector<long long> other;  // iterators not on a shared loop
+    vector<long long> params;
+    long long constant;
+};
+
+inline bool loop_subscript(osl_statement_p s, const vector<long long>& dim,
+                           int common, LoopSubscript& sub) {
+    int in = s->scattering->nb_input_dims;
+    sub.loop.assign(common, 0);
+    sub.other.assign(in, 0);
+    sub.params.assign(dim.begin() + in, dim.end() - 1);
+    sub.constant = dim.back();
+    vector<bool> mapped(in, false);
+    for (int d = 1; d <= common; ++d) {
+        int iter, sign;
+        long long offset;
+        if (!loop_iterator(s->scattering, d, iter, sign, offset)) return false;
+        mapped[iter] = true;
+        sub.loop[d - 1] = dim[iter] * sign;
+        sub.constant += dim[iter] * offset;
+    }
+    for (int k = 0; k < in; ++k)
+        if (!mapped[k]) sub.other[k] = dim[k];
+    return true;
+}
+
+// distance (sink - source loop counters) of the common loops for which
+// the two accesses may touch the same element
+// return false if they never do
+inline bool access_distance(osl_statement_p s, const AccessFunction& a,
+                            osl_statement_p t, const AccessFunction& b,
+                            int common, vector<long long>& dist) {
+    dist.assign(common, 0);
+    vector<bool> known(common, false);
+    for (size_t r = 0; r < a.dims.size(); ++r) {
+        LoopSubscript x, y;
+        if (!loop_subscript(s, a.dims[r], common, x) ||
+            !loop_subscript(t, b.dims[r], common, y) || x.params != y.params)
+            continue;
+        bool other = false;
+        for (auto v : x.other) other |= v != 0;
+        for (auto v : y.other) other |= v != 0;
+
+        // x(c) = y(c + delta):  sum y_e delta_e + (y - x)(c) = x0 - y0
+        long long rhs = x.constant - y.constant;
+        long long g = 0;
+        for (auto v : y.loop) g = gcd_ll(g, v);
+        for (int e = 0; e < common; ++e) g = gcd_ll(g, x.loop[e] - y.loop[e]);
+        for (auto v : x.other) g = gcd_ll(g, v);
+        for (auto v : y.other) g = gcd_ll(g, v);
+        if (g == 0 ? rhs != 0 : rhs % g != 0) return false;
+        if (other || x.loop != y.loop) continue;
+
+        // one loop in the subscript: its distance is fixed,
+        // several loops: only the gcd test above holds
+        int nonzero = 0, e0 = -1;
+        for (int e = 0; e < common; ++e)
+            if (y.loop[e] != 0) ++nonzero, e0 = e;
+        if (nonzero != 1) continue;
+        long long d = rhs / y.loop[e0];
+        if (known[e0] && dist[e0] != d) return false;
+        known[e0] = true;
+        dist[e0] = d;
+    }
+
+    // a loop no subscript pins down can take any distance
+    for (int e = 0; e < common; ++e)
+        if (!known[e]) dist[e] = DIST_ANY;
+    return true;
+}
+
+// the dependences between the statements of the scop (read after read
+// excluded), each oriented from the earlier to the later instance; when
+// the direction is unknown both orientations are returned
+inline vector<Dependence> compute_dependences(osl_scop_p scop) {
+    vector<Dependence> deps;
+    vector<osl_statement_p> statements;
+    for (auto s = scop->statement; s != NULL; s = s->next)
+        statements.push_back(s);
+
+    for (size_t i = 0; i < statements.size(); ++i)
+        for (size_t j = i; j < statements.size(); ++j) {
+            auto s = statements[i], t = statements[j];
+            int common = common_loops(s, t);
+            auto id0 = get_statementID(s->scattering);
+            auto id1 = get_statementID(t->scattering);
+            int d_pos;
+            int order = id_compare(id0, id1, d_pos);
+
+            for (auto la = s->access; la != NULL; la = la->next)
+                for (auto lb = t->access; lb != NULL; lb = lb->next) {
+                    AccessFunction a, b;
+                    bool write_a = la->elt->type != OSL_TYPE_READ;
+                    bool write_b = lb->elt->type != OSL_TYPE_READ;
+                    if (!write_a && !write_b) continue;
+                    vector<long long> dist(common, DIST_ANY);
+                    if (access_function(la->elt, a) &&
+                        access_function(lb->elt, b)) {
+                        if (a.array != b.array ||
+                            a.dims.size() != b.dims.size())
+                            continue;
+                        if (!access_distance(s, a, t, b, common, dist))
+                            continue;
+                    }
+
+                    // orientation: the first non-zero component decides
+                    int first = 0;
+                    while (first < common && dist[first] == 0) ++first;
+                    vector<long long> back = dist;
+                    for (auto& v : back)
+                        if (v != DIST_ANY) v = -v;
+                    if (first == common) {
+                        // same iteration of every common loop: text order
+                        if (s == t) continue;
+                        if (order <= 0)
+                            deps.push_back({s, t, dist});
+                        else
+                            deps.push_back({t, s, back});
+                    } else if (dist[first] == DIST_ANY) {
+                        deps.push_back({s, t, dist});
+                        if (s != t) deps.push_back({t, s, back});
+                    } else if (dist[first] > 0) {
+                        deps.push_back({s, t, dist});
+                    } else {
+                        deps.push_back({t, s, back});
+                    }
+                }
+        }
+    return deps;
+}
+
+// whether the dependence is carried by the loop at depth (1-based): its
+// distance may be non-zero there while zero on the outer loops
+inline bool carried_at(const Dependence& dep, int depth) {
+    if ((int)dep.distance.size() < depth) return false;
+    for (int e = 0; e < depth - 1; ++e)
+        if (dep.distance[e] != 0 && dep.distance[e] != DIST_ANY) return false;
+    return dep.distance[depth - 1] != 0;
+}
+
+// whether the dependence is already satisfied by a loop outside depth
+inline bool satisfied_before(const Dependence& dep, int depth) {
+    for (int e = 0; e < depth - 1 && e < (int)dep.distance.size(); ++e) {
+        if (dep.distance[e] == DIST_ANY) return false;
+        if (dep.distance[e] != 0) return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/* equivalence.cpp compare two SCoPs at the polyhedral level with isl
+ *
+ * the statements are matched by position and the parameters by name, two
+ * SCoPs are equivalent when every statement runs the same instances and
+ * the scatterings order every pair of instances the same way: the domains
+ * and the "happens before" relations are compared, no code is generated
+ */
+
+#include <isl/ctx.h>
+#include <isl/map.h>
+#include <isl/space.h>
+#include <isl/union_map.h>
+#include <isl/union_set.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "affine.h"
+#include "gpt.h"
+#include "polyhedra.h"
+
+using namespace std;
+
+// the pieces of the domain (dims == 0) or the scattering of statement k,
+// the scattering dimensions are padded with zeros up to dims, params names
+// the parameters
+static string isl_pieces(osl_relation_p relation, int k, int dims,
+                         const vector<string>& params) {
+    string pieces;
+    bool scattering = dims > 0;
+    for (auto part = relation; part != NULL; part = part->next) {
+        int out = part->nb_output_dims;
+        int in = scattering ? part->nb_input_dims : out;
+        string piece = "S" + to_string(k) + "[" + to_isl_names("i", in) + "]";
+        if (scattering) {
+            piece += " -> [" + to_isl_names("o", out);
+            for (int d = out; d < dims; ++d) piece += d ? ", 0" : "0";
+            piece += "]";
+        }
+        string constraints =
+            to_isl_constraints(part, scattering, {}, params);
+        if (!constraints.empty()) piece += " : " + constraints;
+        if (!pieces.empty()) pieces += "; ";
+        pieces += piece;
+    }
+    return pieces;
+}
+
+// the instances of the statements and the order the scattering gives them,
+// params holds the isl name of every parameter of the scop
+static bool isl_schedule(isl_ctx* ctx, osl_scop_p scop,
+                         const vector<string>& params,
+                         isl_union_set** instances, isl_union_map** order) {
+    int dims = 0;
+    for (auto s = scop->statement; s != NULL; s = s->next)
+        for (auto part = s->scattering; part != NULL; part = part->next)
+            dims = max(dims, part->nb_output_dims);
+
+    string domain, schedule;
+    int k = 1;
+    for (auto s = scop->statement; s != NULL; s = s->next, ++k) {
+        if (s->domain == NULL || s->scattering == NULL) return false;
+        domain += (domain.empty() ? "" : "; ") +
+                  isl_pieces(s->domain, k, 0, params);
+        schedule += (schedule.empty() ? "" : "; ") +
+                    isl_pieces(s->scattering, k, dims, params);
+    }
+    string header = "[";
+    for (size_t p = 0; p < params.size(); ++p)
+        header += (p ? ", " : "") + params[p];
+    header += "] -> { ";
+    isl_union_set* set =
+        isl_union_set_read_from_str(ctx, (header + domain + " }").c_str());
+    isl_union_map* map =
+        isl_union_map_read_from_str(ctx, (header + schedule + " }").c_str());
+    if (set == NULL || map == NULL) {
+        isl_union_set_free(set);
+        isl_union_map_free(map);
+        return false;
+    }
+
+    // an instance without a date is never run
+    map = isl_union_map_intersect_domain(map, set);
+    *instances = isl_union_map_domain(isl_union_map_copy(map));
+
+    // x before y  <=>  date(x) <<_lex date(y)
+    isl_map* lex = isl_map_lex_lt(isl_space_set_alloc(ctx, 0, dims));
+    *order = isl_union_map_apply_range(isl_union_map_copy(map),
+                                       isl_union_map_from_map(lex));
+    *order = isl_union_map_apply_range(*order, isl_union_map_reverse(map));
+    return true;
+}
+
+// the names of the parameters, positional ones when the scop has none
+static vector<string> scop_parameters(osl_scop_p scop) {
+    auto names = parameter_names(scop);
+    if (names.empty() && scop->context != NULL)
+        for (int p = 0; p < scop->context->nb_parameters; ++p)
+            names.push_back("p" + to_string(p));
+    return names;
+}
+
+static bool scop_pair_equivalent(isl_ctx* ctx, osl_scop_p scop,
+                                 osl_scop_p reference, string& difference) {
+    int nb_statements[2] = {0, 0};
+    for (auto s = scop->statement; s != NULL; s = s->next) ++nb_statements[0];
+    for (auto s = reference->statement; s != NULL; s = s->next)
+        ++nb_statements[1];
+    if (nb_statements[0] != nb_statements[1]) {
+        difference = to_string(nb_statements[0]) + " statements instead of " +
+                     to_string(nb_statements[1]);
+        return false;
+    }
+
+    // the parameters are matched by name, p<k> for the k-th parameter of
+    // the reference: isl aligns the parameters of both sides on their names
+    auto names = scop_parameters(scop);
+    auto reference_names = scop_parameters(reference);
+    vector<string> params, reference_params;
+    for (size_t p = 0; p < reference_names.size(); ++p)
+        reference_params.push_back("p" + to_string(p));
+    for (auto& name : names) {
+        auto it = find(reference_names.begin(), reference_names.end(), name);
+        if (it == reference_names.end()) break;
+        params.push_back("p" + to_string(it - reference_names.begin()));
+    }
+    if (names.size() != reference_names.size() ||
+        params.size() != names.size()) {
+        difference = "not the same parameters";
+        return false;
+    }
+
+    isl_union_set* instances[2] = {NULL, NULL};
+    isl_union_map* order[2] = {NULL, NULL};
+    bool ok =
+        isl_schedule(ctx, scop, params, &instances[0], &order[0]) &&
+        isl_schedule(ctx, reference, reference_params, &instances[1],
+                     &order[1]);
+    bool equal = false;
+    if (!ok)
+        difference = "cannot read the relations with isl";
+    else if (isl_union_set_is_equal(instances[0], instances[1]) != 1)
+        difference = "the statement instances differ";
+    else if (isl_union_map_is_equal(order[0], order[1]) != 1)
+        difference = "the execution order differs";
+    else
+        equal = true;
+    for (int k = 0; k < 2; ++k) {
+        isl_union_set_free(instances[k]);
+        isl_union_map_free(order[k]);
+    }
+    return equal;
+}
+
+bool scop_equivalent(osl_scop_p scop, osl_scop_p reference,
+                     std::string& difference) {
+    isl_ctx* ctx = isl_ctx_alloc();
+    bool equal = true;
+    int k = 1;
+    for (; scop != NULL && reference != NULL && equal;
+         scop = scop->next, reference = reference->next, ++k)
+        if (!scop_pair_equivalent(ctx, scop, reference, difference)) {
+            difference = "scop " + to_string(k) + ": " + difference;
+            equal = false;
+        }
+    if (equal && (scop != NULL || reference != NULL)) {
+        difference = "not the same number of scops";
+        equal = false;
+    }
+    isl_ctx_free(ctx);
+    return equal;
+}
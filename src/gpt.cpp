@@ -0,0 +1,505 @@
+/* gpt.cpp loading, transforming and printing an in-memory SCoP */
+
+#include "gpt.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "compose.h"
+#include "parallel.h"
+#include "parser.h"
+#include "raii.h"
+#include "utility.h"
+
+using namespace std;
+
+/* Use the Clan library to convert a SCoP from C to OpenScop */
+osl_scop_p read_scop_from_c(FILE* input, char* input_name) {
+    clan_options_p clanoptions;
+    osl_scop_p scop;
+    clanoptions = clan_options_malloc();
+    clanoptions->precision = OSL_PRECISION_MP;
+    CLAN_strdup(clanoptions->name, input_name);
+    scop = clan_scop_extract(input, clanoptions);
+    clan_options_free(clanoptions);
+    return scop;
+}
+
+osl_scop_p read_scop_from_string(const string& source,
+                                 const char* input_name) {
+    OwnedFile input(fmemopen((void*)source.data(), source.length(), "r"));
+    if (!input) return NULL;
+    return read_scop_from_c(input.get(), (char*)input_name);
+}
+
+osl_scop_p read_scop_from_openscop(const string& text) {
+    OwnedFile input(fmemopen((void*)text.data(), text.length(), "r"));
+    if (!input) return NULL;
+    return osl_scop_read(input.get());
+}
+
+// mark the parallel loops of the osl_loop extension in the clast, so that
+// clast_pprint prints them with "#pragma omp parallel for"
+static void annotate_loops(osl_scop_p scop, struct clast_stmt* root) {
+    osl_loop_p loop =
+        (osl_loop_p)osl_generic_lookup(scop->extension, OSL_URI_LOOP);
+    for (; loop != NULL; loop = loop->next) {
+        if (!(loop->directive & OSL_LOOP_DIRECTIVE_PARALLEL)) continue;
+        ClastFilter filter = {loop->iter, loop->stmt_ids, (int)loop->nb_stmts,
+                              subset};
+        struct clast_for** loops;
+        int nb_loops, nb_stmts;
+        int* stmts;
+        clast_filter(root, filter, &loops, &nb_loops, &stmts, &nb_stmts);
+        for (int i = 0; i < nb_loops; ++i) {
+            // CLooG built with OpenScop support may have done it already
+            if (loops[i]->parallel & CLAST_PARALLEL_OMP) continue;
+            loops[i]->parallel |= CLAST_PARALLEL_OMP;
+            if (loop->private_vars != NULL)
+                loops[i]->private_vars = strdup(loop->private_vars);
+        }
+        free(loops);
+        free(stmts);
+    }
+}
+
+// whether the scattering dimension dim is a beta equal to 0 in every
+// statement that has it, and no statement would be left without dimension
+static bool zero_dimension(osl_scop_p scop, int dim) {
+    for (auto s = scop->statement; s != NULL; s = s->next)
+        for (auto part = s->scattering; part != NULL; part = part->next) {
+            if (dim >= part->nb_output_dims) continue;
+            if (part->nb_output_dims == 1) return false;
+            int constant_pos = part->nb_columns - 1;
+            int rows = 0;
+            for (int row = 0; row < part->nb_rows; ++row) {
+                if (osl_int_zero(part->precision, part->m[row][dim + 1]))
+                    continue;
+                ++rows;
+                if (!osl_int_zero(part->precision, part->m[row][0]) ||
+                    !osl_int_zero(part->precision, part->m[row][constant_pos]))
+                    return false;
+                for (int col = 1; col < constant_pos; ++col)
+                    if (col != dim + 1 &&
+                        !osl_int_zero(part->precision, part->m[row][col]))
+                        return false;
+            }
+            if (rows != 1) return false;
+        }
+    return true;
+}
+
+// remove the dimension dim, and the row that sets it, from the scattering
+// of every statement that has it
+static void drop_dimension(osl_scop_p scop, int dim) {
+    for (auto s = scop->statement; s != NULL; s = s->next)
+        for (osl_relation_p* link = &s->scattering; *link != NULL;
+             link = &(*link)->next) {
+            osl_relation_p part = *link;
+            if (dim >= part->nb_output_dims) continue;
+            int precision = part->precision;
+            osl_relation_p smaller = osl_relation_pmalloc(
+                precision, part->nb_rows - 1, part->nb_columns - 1);
+            osl_relation_set_type(smaller, part->type);
+            osl_relation_set_attributes(smaller, part->nb_output_dims - 1,
+                                        part->nb_input_dims,
+                                        part->nb_local_dims,
+                                        part->nb_parameters);
+            int r = 0;
+            for (int row = 0; row < part->nb_rows; ++row) {
+                if (!osl_int_zero(precision, part->m[row][dim + 1])) continue;
+                int c = 0;
+                for (int col = 0; col < part->nb_columns; ++col)
+                    if (col != dim + 1)
+                        osl_int_assign(precision, &smaller->m[r][c++],
+                                       part->m[row][col]);
+                ++r;
+            }
+            smaller->next = part->next;
+            part->next = NULL;
+            osl_relation_free(part);
+            *link = smaller;
+        }
+
+    osl_scatnames_p scat = (osl_scatnames_p)osl_generic_lookup(
+        scop->extension, OSL_URI_SCATNAMES);
+    if (scat == NULL || scat->names == NULL ||
+        dim >= (int)osl_strings_size(scat->names))
+        return;
+    char** names = scat->names->string;
+    free(names[dim]);
+    for (int k = dim; names[k] != NULL; ++k) names[k] = names[k + 1];
+}
+
+// the scop CLooG gets: a copy without redundant rows nor dead statements,
+// with dense betas and without the beta dimensions that are 0 for every
+// statement, so that it has fewer and smaller polyhedra to scan
+static OwnedScop codegen_scop(osl_scop_p scop) {
+    OwnedScop owned = clone_scop(scop);
+    osl_scop_p copy = owned.get();
+    simplify_scop(copy);
+    normalize_betas(copy);
+    int dims = 0;
+    for (auto s = copy->statement; s != NULL; s = s->next)
+        dims = max(dims, s->scattering->nb_output_dims);
+    // from the last one, the indexes of the others do not move
+    for (int dim = dims - 1; dim >= 0; dim -= 1)
+        if (dim % 2 == 0 && zero_dimension(copy, dim))
+            drop_dimension(copy, dim);
+    return owned;
+}
+
+/* Use the CLooG library to output a SCoP from OpenScop to C */
+void print_scop_to_c(FILE* output, osl_scop_p scop) {
+    OwnedScop copy = codegen_scop(scop);
+    CloogSession cloog;
+    CloogOptions* options = cloog.options;
+    options->openscop = 1;
+    cloog_options_copy_from_osl_scop(copy.get(), options);
+    // the input is freed by cloog_clast_create_from_input
+    CloogInput* input = cloog_input_from_osl_scop(cloog.state, copy.get());
+    struct clast_stmt* clast = cloog_clast_create_from_input(input, options);
+    annotate_loops(copy.get(), clast);
+    clast_pprint(output, clast, 0, options);
+    cloog_clast_free(clast);
+}
+
+string print_scop_to_string(osl_scop_p scop) {
+    char* buffer = NULL;
+    size_t size = 0;
+    FILE* output = open_memstream(&buffer, &size);
+    if (output == NULL) return string();
+    print_scop_to_c(output, scop);
+    fclose(output);
+    OwnedString owned(buffer);
+    return string(buffer, size);
+}
+
+// arguments of each transformation, indexed by the parser id: v a vector,
+// i an integer, a either of them, the ones after '/' are optional
+static const char* signatures[] = {"",     "vi",   "vv",    "viii", "v",
+                                   "viii", "viii", "vi",    "vi",   "vii",
+                                   "v",    "vi",   "vv",    "vii/i", "vi/i",
+                                   "via",  "v",    "v"};
+
+// whether the arguments match the signature of func
+static bool check_args(int func, const vector<BaseArg*>& args,
+                       const string& command) {
+    string signature = signatures[func];
+    size_t required = signature.find('/');
+    if (required == string::npos) required = signature.length();
+    signature.erase(required, 1);
+    if (args.size() < required) {
+        cerr << "Missing arguments: " << command << endl;
+        return false;
+    }
+    for (size_t k = 0; k < args.size() && k < signature.length(); ++k) {
+        char kind = args[k]->type == 0 ? 'i' : 'v';
+        if (signature[k] != 'a' && signature[k] != kind) {
+            cerr << "Argument " << k + 1 << " should be "
+                 << (signature[k] == 'v' ? "a vector" : "an integer") << ": "
+                 << command << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// parse a command and check its arguments, return the parser id or 0
+static int parse_command(string command, vector<BaseArg*>& args,
+                         bool verbose) {
+    int func = parser(command, args, verbose);
+    if (func == 0) return 0;
+    if (!check_args(func, args, command)) return 0;
+    if (verbose)
+        for (auto ptr : args) {
+            if (ptr->type == 0)
+                ((SingleIntArg*)ptr)->display();
+            else
+                ((VectorArg*)ptr)->display();
+        }
+    return func;
+}
+
+static int dispatch(osl_scop_p scop, int func, vector<BaseArg*>& args) {
+    int ret = 0;
+    switch (func) {
+        case SPLIT: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            ret = split(scop, arg0->arg, arg1->arg);
+            break;
+        }
+        case REORDER: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (VectorArg*)args[1];
+            ret = reorder(scop, arg0->arg, arg1->arg);
+            break;
+        }
+        case INTERCHANGE: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            auto arg2 = (SingleIntArg*)args[2];
+            auto arg3 = (SingleIntArg*)args[3];
+            ret = interchange(scop, arg0->arg, arg1->arg, arg2->arg,
+                              arg3->arg);
+            break;
+        }
+        case FUSE: {
+            auto arg0 = (VectorArg*)args[0];
+            ret = fuse(scop, arg0->arg);
+            break;
+        }
+        case SKEW: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            auto arg2 = (SingleIntArg*)args[2];
+            auto arg3 = (SingleIntArg*)args[3];
+            ret = skew(scop, arg0->arg, arg1->arg, arg2->arg, arg3->arg);
+            break;
+        }
+        case TILE: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            auto arg2 = (SingleIntArg*)args[2];
+            auto arg3 = (SingleIntArg*)args[3];
+            ret = tile(scop, arg0->arg, arg1->arg, arg2->arg, arg3->arg);
+            break;
+        }
+        case REVERSE: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            ret = reverse(scop, arg0->arg, arg1->arg);
+            break;
+        }
+        case UNROLL_JAM: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            auto arg2 = (SingleIntArg*)args[2];
+            ret = unroll_jam(scop, arg0->arg, arg1->arg, arg2->arg);
+            break;
+        }
+        case DISTRIBUTE: {
+            auto arg0 = (VectorArg*)args[0];
+            ret = distribute(scop, arg0->arg);
+            break;
+        }
+        case PEEL: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            ret = peel(scop, arg0->arg, arg1->arg);
+            break;
+        }
+        case INDEX_SET_SPLIT: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (VectorArg*)args[1];
+            ret = index_set_split(scop, arg0->arg, arg1->arg);
+            break;
+        }
+        case STRIPMINE: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            auto arg2 = (SingleIntArg*)args[2];
+            // the SIMD width is optional
+            int lanes = args.size() > 3 ? ((SingleIntArg*)args[3])->arg : 0;
+            ret = lanes < 0 ? -1
+                            : strip_mine(scop, arg0->arg, arg1->arg,
+                                         arg2->arg, lanes);
+            break;
+        }
+        case WAVEFRONT: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            // by default the band takes every loop of the nest from depth
+            int levels = args.size() > 2 ? ((SingleIntArg*)args[2])->arg : 0;
+            ret = wavefront(scop, arg0->arg, arg1->arg, levels);
+            break;
+        }
+        case SHIFT: {
+            auto arg0 = (VectorArg*)args[0];
+            auto arg1 = (SingleIntArg*)args[1];
+            // a constant amount or [parameter coefficients..., constant]
+            vector<int> amount;
+            if (args[2]->type == 0)
+                amount.push_back(((SingleIntArg*)args[2])->arg);
+            else
+                amount = ((VectorArg*)args[2])->arg;
+            ret = shift(scop, arg0->arg, arg1->arg, amount);
+            break;
+        }
+        case AUTOFUSE: {
+            auto arg0 = (VectorArg*)args[0];
+            ret = auto_fuse(scop, arg0->arg);
+            break;
+        }
+        case PERMUTE: {
+            auto arg0 = (VectorArg*)args[0];
+            ret = permute(scop, arg0->arg);
+            break;
+        }
+        default:
+            cerr << "Unknown transformation: " << func << endl;
+            ret = -1;
+            break;
+    }
+    return ret;
+}
+
+// record the unimodular commands in the chain instead of running them
+static bool chain_command(UnimodularChain& chain, osl_scop_p scop, int func,
+                          vector<BaseArg*>& args) {
+    switch (func) {
+        case INTERCHANGE:
+            chain.add_interchange(scop, ((VectorArg*)args[0])->arg,
+                                  ((SingleIntArg*)args[1])->arg,
+                                  ((SingleIntArg*)args[2])->arg,
+                                  ((SingleIntArg*)args[3])->arg);
+            return true;
+        case SKEW:
+            chain.add_skew(((VectorArg*)args[0])->arg,
+                           ((SingleIntArg*)args[1])->arg,
+                           ((SingleIntArg*)args[2])->arg,
+                           ((SingleIntArg*)args[3])->arg);
+            return true;
+        case REVERSE:
+            chain.add_reverse(((VectorArg*)args[0])->arg,
+                              ((SingleIntArg*)args[1])->arg);
+            return true;
+        default:
+            return false;
+    }
+}
+
+int transformation(osl_scop_p scop, string command, bool verbose) {
+    ArgList args;
+    int func = parse_command(command, args, verbose);
+    return func == 0 ? -1 : dispatch(scop, func, args);
+}
+
+int apply_script(osl_scop_p scop, string script, bool verbose) {
+    UnimodularChain chain;
+    int ret = 0;
+    for (auto command : split_script(script)) {
+        ArgList args;
+        int func = parse_command(command, args, verbose);
+        if (func == 0) {
+            ret = -1;
+        } else if (!chain_command(chain, scop, func, args)) {
+            // any other command sees the chain applied first
+            chain.apply(scop);
+            ret = dispatch(scop, func, args);
+        }
+        if (ret != 0) break;
+    }
+    chain.apply(scop);
+    return ret;
+}
+
+int apply_clay(osl_scop_p scop, bool verbose) {
+    return apply_script(scop, get_trans(scop->extension), verbose);
+}
+
+// detach the SCoPs of a list so that each one can be handled alone
+static vector<osl_scop_p> detach_scops(osl_scop_p scop) {
+    vector<osl_scop_p> scops;
+    for (; scop != NULL; scop = scop->next) scops.push_back(scop);
+    for (auto s : scops) s->next = NULL;
+    return scops;
+}
+
+static void relink_scops(vector<osl_scop_p>& scops) {
+    for (size_t i = 0; i + 1 < scops.size(); ++i) scops[i]->next = scops[i + 1];
+}
+
+int apply_clay_all(osl_scop_p scop, int jobs, bool verbose) {
+    auto scops = detach_scops(scop);
+    vector<int> status(scops.size());
+    // the argument dump would interleave between threads
+    verbose = verbose && scops.size() == 1;
+    parallel_for(scops.size(), jobs,
+                 [&](int i) { status[i] = apply_clay(scops[i], verbose); });
+    relink_scops(scops);
+
+    int failed = 0;
+    for (size_t i = 0; i < status.size(); ++i)
+        if (status[i] != 0) {
+            cerr << "transformation of scop " << i + 1 << " failed" << endl;
+            ++failed;
+        }
+    return failed;
+}
+
+// one copy of the scop per top-level beta, with only its statements
+// the subtrees are independent nests, CLooG prints them in order
+static vector<OwnedScop> split_subtrees(osl_scop_p scop) {
+    set<int> betas;
+    for (auto s = scop->statement; s != NULL; s = s->next)
+        betas.insert(get_statementID(s->scattering)[0]);
+
+    vector<OwnedScop> subtrees;
+    if (betas.size() < 2) return subtrees;
+    for (int beta : betas) {
+        OwnedScop owned = clone_scop(scop);
+        osl_scop_p copy = owned.get();
+        vector<int> number;
+        int kept = 0;
+        for (osl_statement_p* link = &copy->statement; *link != NULL;) {
+            osl_statement_p s = *link;
+            if (get_statementID(s->scattering)[0] == beta) {
+                number.push_back(++kept);
+                link = &s->next;
+                continue;
+            }
+            *link = s->next;
+            s->next = NULL;
+            osl_statement_free(s);
+            number.push_back(0);
+        }
+        renumber_loops(copy, number);
+        subtrees.push_back(move(owned));
+    }
+    return subtrees;
+}
+
+vector<string> print_scops_to_strings(osl_scop_p scop, int jobs) {
+    auto scops = detach_scops(scop);
+
+    // with more than one job asked for, the top-level subtrees of every
+    // scop are generated apart, each in its own CloogState
+    vector<osl_scop_p> parts;
+    vector<int> owner;
+    vector<OwnedScop> copies;
+    for (size_t i = 0; i < scops.size(); ++i) {
+        auto subtrees =
+            jobs > 1 ? split_subtrees(scops[i]) : vector<OwnedScop>();
+        if (subtrees.empty()) {
+            parts.push_back(scops[i]);
+            owner.push_back(i);
+        }
+        for (auto& part : subtrees) {
+            parts.push_back(part.get());
+            owner.push_back(i);
+            copies.push_back(move(part));
+        }
+    }
+    vector<string> part_code(parts.size());
+    parallel_for(parts.size(), jobs, [&](int i) {
+        part_code[i] = print_scop_to_string(parts[i]);
+    });
+
+    vector<string> code(scops.size());
+    for (size_t i = 0; i < parts.size(); ++i) code[owner[i]] += part_code[i];
+    relink_scops(scops);
+    return code;
+}
+
+void print_scops_to_c(FILE* output, osl_scop_p scop, int jobs) {
+    auto code = print_scops_to_strings(scop, jobs);
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (i > 0) fputc('\n', output);
+        fputs(code[i].c_str(), output);
+    }
+}
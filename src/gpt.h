@@ -0,0 +1,423 @@
+/* gpt.h the embeddable interface of the Geometric-Polyhedron-Transformer
+ *
+ * Everything works on an in-memory osl_scop: load it from C or OpenScop,
+ * apply Clay transformations or whole scripts, then generate C code into a
+ * FILE or a string buffer. Link with build/libgpt.a (or libgpt.so) and
+ * -lcloog-isl -lisl -lclan -losl -ldl.
+ */
+
+#ifndef GPT_H
+#define GPT_H
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Use the Clan library to convert a SCoP from C to OpenScop */
+osl_scop_p read_scop_from_c(FILE* input, char* input_name);
+
+/* Same as read_scop_from_c, the C source is held in memory */
+osl_scop_p read_scop_from_string(const std::string& source,
+                                 const char* input_name);
+
+/* Read an OpenScop text held in memory */
+osl_scop_p read_scop_from_openscop(const std::string& text);
+
+/* Use the CLooG library to output a SCoP from OpenScop to C */
+void print_scop_to_c(FILE* output, osl_scop_p scop);
+
+/* Same as print_scop_to_c, the C code is returned as a string */
+std::string print_scop_to_string(osl_scop_p scop);
+
+/* Compact binary OpenScop, see binary.cpp */
+
+/* Write the SCoP list in the binary format, return 0 on success */
+int write_scop_binary(FILE* output, osl_scop_p scop);
+
+/* Read a SCoP list written by write_scop_binary, NULL on error */
+osl_scop_p read_scop_binary(FILE* input);
+
+/* Check the magic number of a seekable file without consuming it */
+bool is_scop_binary(FILE* input);
+
+/* Read either a binary or a textual OpenScop file */
+osl_scop_p read_scop_from_file(FILE* input);
+
+/* Standalone C kernels, see kernel.cpp */
+
+/* An array touched by a SCoP and the box of its subscripts */
+struct KernelArray {
+    std::string name;
+    int id;
+    std::vector<long long> lower;   // first subscript of each dimension
+    std::vector<long long> extent;  // number of subscripts of each dimension
+};
+
+/* The parameters and arrays a kernel of the SCoP is called with */
+struct KernelLayout {
+    std::vector<std::string> params;
+    std::vector<KernelArray> arrays;
+};
+
+/* The includes and the macros (floord, ceild, max, min) the code of a
+ * kernel needs, to put before the kernels of a C file */
+std::string kernel_prelude();
+
+/** kernel_layout function
+ * Compute the arrays of the SCoP and their bounds when its parameters take
+ * the given values, from the domains and the access relations
+ * return false if some access is not affine or not bounded
+ */
+bool kernel_layout(osl_scop_p scop, const std::vector<long>& params,
+                   KernelLayout& layout);
+
+/** kernel_source function
+ * Wrap code generated for scop (or its original C text) into the function
+ *   void name(const long* gpt_params, double** gpt_arrays,
+ *             const long* gpt_shape)
+ * every array element is a double, gpt_shape is given by kernel_shape()
+ */
+std::string kernel_source(osl_scop_p scop, const KernelLayout& layout,
+                          const std::string& code, const std::string& name);
+
+/* The gpt_shape argument of a kernel: lower bounds then extents per array */
+std::vector<long> kernel_shape(const KernelLayout& layout);
+
+/* Number of elements to allocate for an array of the layout */
+long kernel_array_size(const KernelArray& array);
+
+/* In-process execution, see jit.cpp */
+
+/* A SCoP built into a shared object and loaded in the process */
+struct JitKernel {
+    void* handle = NULL;
+    void (*function)(const long*, double**, const long*) = NULL;
+    KernelLayout layout;
+    std::vector<long> params;  // the parameter values it runs with
+    std::vector<long> shape;   // kernel_shape(layout)
+};
+
+/** jit_compile function
+ * Generate the code of the scop, wrap it with kernel_source(), build it
+ * with cc into a shared object and load it with dlopen
+ * params: the values of the parameters, they fix the array bounds
+ * cc, cflags: split at blanks and run without a shell
+ * return false if the layout, the compiler or the loader fails
+ */
+bool jit_compile(osl_scop_p scop, const std::vector<long>& params,
+                 JitKernel& kernel, const std::string& cc = "cc",
+                 const std::string& cflags = "-O2");
+
+/* The arrays of a kernel, kernel_array_size() doubles each, initialized
+ * with the values the bench driver uses */
+std::vector<std::vector<double>> jit_arrays(const JitKernel& kernel);
+
+/** jit_run function
+ * Run the kernel reps times on the arrays
+ * return the best time in seconds, -1 if the kernel is not loaded
+ */
+double jit_run(const JitKernel& kernel,
+               std::vector<std::vector<double>>& arrays, int reps = 1);
+
+/* Unload the shared object of a kernel */
+void jit_free(JitKernel& kernel);
+
+/* Static cache model, see cache_model.cpp */
+
+/* One cache level, sizes in bytes */
+struct CacheConfig {
+    long size = 32768;
+    long line = 64;
+    long element = 8;  // size of an array element
+};
+
+struct CacheEstimate {
+    double accesses = 0;  // memory accesses of all the statement instances
+    double misses = 0;    // predicted misses, -1 if the schedule is invalid
+    double reuse = 0;     // mean reuse distance of the references, in bytes
+};
+
+/** estimate_cache function
+ * Predict the cache misses of the current schedule of the scop for the
+ * given parameter values, from its access relations and scattering
+ * verbose prints the strides and reuse distance of every reference
+ * return false if the scop is out of the model (non affine accesses...)
+ */
+bool estimate_cache(osl_scop_p scop, const std::vector<long>& params,
+                    const CacheConfig& cache, CacheEstimate& estimate,
+                    bool verbose = false);
+
+/** rank_schedules function
+ * Apply every script to the scop in a transaction, estimate its misses
+ * and roll it back
+ * return the indexes of the scripts, the cheapest first
+ */
+std::vector<int> rank_schedules(osl_scop_p scop,
+                                const std::vector<std::string>& scripts,
+                                const std::vector<long>& params,
+                                const CacheConfig& cache,
+                                std::vector<CacheEstimate>& estimates);
+
+/** simplify_scop function
+ * Remove with isl the rows of the domains and scatterings the other rows
+ * imply, and the statements whose domain is empty (see simplify.cpp)
+ * print_scop_to_c runs it on the copy it generates code from
+ * return the number of rows and statements removed
+ */
+int simplify_scop(osl_scop_p scop);
+
+/** scop_equivalent function
+ * Compare two SCoP lists at the polyhedral level (see equivalence.cpp):
+ * matched by position, the statements must run the same instances in the
+ * same order, no code is generated
+ * difference: what differs first, when they are not equivalent
+ */
+bool scop_equivalent(osl_scop_p scop, osl_scop_p reference,
+                     std::string& difference);
+
+/** transformation function
+ * Apply one Clay command, e.g. "interchange([0], 1, 2, 1)"
+ * return 0 on success, -1 on an unknown or failed command
+ */
+int transformation(osl_scop_p scop, std::string command, bool verbose);
+
+/** apply_script function
+ * Apply a Clay script (commands separated by ';') in order
+ * consecutive interchange/skew/reverse commands are folded into a single
+ * matrix update of each scattering
+ * stop at the first failed command and return its status
+ */
+int apply_script(osl_scop_p scop, std::string script, bool verbose = false);
+
+/* Apply the script found in the "clay" extension of the SCoP */
+int apply_clay(osl_scop_p scop, bool verbose = false);
+
+/** apply_clay_all function
+ * Apply its own clay script to every SCoP of the list, the SCoPs are
+ * independent and are transformed on up to jobs threads (0: one per core)
+ * return the number of SCoPs whose script failed
+ */
+int apply_clay_all(osl_scop_p scop, int jobs, bool verbose = false);
+
+/* Generate the code of every SCoP of the list, in order, on jobs threads
+ * with jobs > 1 the top-level loop nests of a SCoP are generated apart
+ * and concatenated, each with its own CLooG state */
+void print_scops_to_c(FILE* output, osl_scop_p scop, int jobs);
+
+/* Same as print_scops_to_c, one string per SCoP */
+std::vector<std::string> print_scops_to_strings(osl_scop_p scop, int jobs);
+
+/* Transactions, see journal.cpp */
+
+/* What one command may change, saved before it runs */
+struct JournalStep {
+    std::vector<osl_statement_p> statements;  // the statement list
+    std::vector<osl_statement_p> saved;  // statements under the command
+    std::vector<osl_relation_p> scatterings, domains;  // their copies
+    osl_strings_p names = NULL;  // the scattering names
+    osl_loop_p loops = NULL;     // the osl_loop extension
+};
+
+/* The commands applied to a SCoP since transaction_begin(), undone last
+ * first; the log is dropped (the changes kept) when it goes away */
+struct ScopTransaction {
+    osl_scop_p scop = NULL;
+    std::vector<JournalStep> steps;
+
+    ScopTransaction() {}
+    ScopTransaction(const ScopTransaction&) = delete;
+    ScopTransaction& operator=(const ScopTransaction&) = delete;
+    ~ScopTransaction();
+};
+
+/* Start logging the commands applied to scop, dropping any older log */
+void transaction_begin(osl_scop_p scop, ScopTransaction& transaction);
+
+/** transaction_apply function
+ * Apply one Clay command as transformation() does, after saving what it
+ * may change: the statements under the loop it names and their siblings
+ * a failed command is undone right away
+ * return the status of the command
+ */
+int transaction_apply(ScopTransaction& transaction,
+                      const std::string& command, bool verbose = false);
+
+/* Apply the commands of a script one by one, stop at the first failure */
+int transaction_apply_script(ScopTransaction& transaction,
+                             const std::string& script,
+                             bool verbose = false);
+
+/* Undo the last command, return false if there is none */
+bool transaction_undo(ScopTransaction& transaction);
+
+/* Undo every command since transaction_begin() */
+void transaction_rollback(ScopTransaction& transaction);
+
+/* Keep the changes and drop the log */
+void transaction_commit(ScopTransaction& transaction);
+
+/* Source-to-source rewriting, see rewrite.cpp */
+
+/* A "#pragma scop" ... "#pragma endscop" region, as byte offsets */
+struct ScopRegion {
+    size_t begin;        // start of the "#pragma scop" line
+    size_t body;         // first byte after that line
+    size_t body_end;     // start of the "#pragma endscop" line
+    size_t end;          // first byte after that line
+    std::string indent;  // leading blanks of the "#pragma scop" line
+};
+
+/* Find the SCoP regions of a C source, in order */
+std::vector<ScopRegion> find_scop_regions(const std::string& source);
+
+/** rewrite_source function
+ * Replace the body of every SCoP region of a C source by the code of its
+ * transformed SCoP, everything else (pragmas included) is copied through
+ * iterators introduced by the transformations are declared in a block
+ * return 0 on success, -1 if a region could not be extracted or transformed
+ */
+int rewrite_source(const std::string& source, const char* name,
+                   std::string& result, int jobs,
+                   const std::string& cache_dir = "");
+
+/* Front-end cache, see scop_cache.cpp */
+
+/* FNV-1a hash of a normalized region text, the name of its cache entry */
+unsigned long long scop_region_hash(const std::string& text);
+
+/** read_scop_from_string_cached function
+ * Same as read_scop_from_string, Clan runs on each SCoP region alone and
+ * its result (without the clay extension) is kept in cache_dir as a binary
+ * scop keyed by the region text without its Clay comment: an unchanged
+ * region is read back instead, its Clay script taken from the source;
+ * falls back to read_scop_from_string if a region cannot be extracted alone
+ */
+osl_scop_p read_scop_from_string_cached(const std::string& source,
+                                        const char* input_name,
+                                        const std::string& cache_dir);
+
+/* Clay transformations, see transform.cpp */
+
+int split(osl_scop_p scop, std::vector<int> statementID, unsigned int depth);
+
+int reorder(osl_scop_p scop, std::vector<int> loopID,
+            std::vector<int> neworder);
+
+int interchange(osl_scop_p scop, std::vector<int> loopID, unsigned int depth_1,
+                unsigned int depth_2, int pretty);
+
+int fuse(osl_scop_p scop, std::vector<int> loopID);
+
+int skew(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+         unsigned int depth_other, int coeff);
+
+int tile(osl_scop_p scop, std::vector<int> statementID, unsigned int depth,
+         unsigned int depth_outer, unsigned int size);
+
+/** strip_mine function
+ * Strip-mine the loop at depth into strips of size iterations, the strip
+ * loop takes its place and the loop runs inside (no interchange)
+ * lanes: the SIMD width of the machine that runs the generated code, in
+ * elements (e.g. 4 doubles for AVX), size is rounded up to a multiple of it;
+ * 0 keeps size
+ * return status
+ */
+int strip_mine(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+               unsigned int size, unsigned int lanes = 0);
+
+int reverse(osl_scop_p scop, std::vector<int> loopID, unsigned int depth);
+
+/** unroll_jam function
+ * Unroll the loop at depth by factor and fuse the copies into its body
+ * loopID: the statements of the loop nest to transform
+ * the remainder iterations are kept, guarded in the generated code
+ * return status
+ */
+int unroll_jam(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+               unsigned int factor);
+
+/** distribute function
+ * Split the loop loopID into several loops, from the dependence graph of
+ * its statements: the statements of a dependence cycle stay together, the
+ * ones with a dependence carried by the loop are kept apart from the ones
+ * that can run vectorized or in parallel
+ * return status
+ */
+int distribute(osl_scop_p scop, std::vector<int> loopID);
+
+/** peel function
+ * Move the first n iterations of the loop loopID (the last -n ones if n is
+ * negative) to a loop of their own, next to the main loop
+ * return status
+ */
+int peel(osl_scop_p scop, std::vector<int> loopID, int n);
+
+/** index_set_split function
+ * Split the loop loopID at an affine point of the parameters: the
+ * iterations below it stay, the other ones move to a new loop right after
+ * point: the constant, or the coefficient of every parameter then the
+ * constant
+ * return status
+ */
+int index_set_split(osl_scop_p scop, std::vector<int> loopID,
+                    std::vector<int> point);
+
+/** shift function
+ * Shift the loop at depth of the statements of statementID by amount
+ * iterations (retiming), e.g. to align a consumer with its producer
+ * before fuse
+ * amount: the constant, or the coefficient of every parameter then the
+ * constant
+ * return status
+ */
+int shift(osl_scop_p scop, std::vector<int> statementID, unsigned int depth,
+          std::vector<int> amount);
+
+/** auto_fuse function
+ * Fuse the loops under loopID ([] for the whole scop) greedily: the
+ * neighbour loops sharing the most arrays first, when no dependence
+ * between them is reversed, then the loops inside the fused ones
+ * return status
+ */
+int auto_fuse(osl_scop_p scop, std::vector<int> loopID);
+
+/** permute function
+ * Move the loop of the nest loopID ([] for every outermost nest) that gives
+ * stride-1 access to the most referenced arrays innermost, with the
+ * interchanges of interchange(), when the dependences allow it
+ * return status
+ */
+int permute(osl_scop_p scop, std::vector<int> loopID);
+
+/** wavefront function
+ * Skew the band of levels loops from depth (0: every loop the nest shares)
+ * so that the loop at depth runs the wavefronts in sequence and the loop
+ * below it is parallel, the latter is printed as an OpenMP loop
+ * return status
+ */
+int wavefront(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+              unsigned int levels = 0);
+
+/** normalize_betas function
+ * Renumber the betas (the scalar dimensions of the scattering) densely,
+ * the children of every node of the beta tree become 0, 1, 2, ...
+ * return status
+ */
+int normalize_betas(osl_scop_p scop);
+
+// BONUS
+/** unroll function
+ * Unroll a loop
+ * scop: the SCoP to be transformed
+ * statementID: the statement scattering ID on AST
+ * factor: unroll factor
+ * return status
+ */
+// int unroll(osl_scop_p scop, std::vector<int> statementID, unsigned int
+// factor);
+
+#endif
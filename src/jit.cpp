@@ -0,0 +1,109 @@
+/* jit.cpp run the code generated for a SCoP inside the process
+ *
+ * the code is wrapped into a kernel (see kernel.cpp), built by the local C
+ * compiler into a shared object and loaded with dlopen, so that a tuning
+ * loop can time many schedules without writing a driver for each of them
+ */
+
+#include <dlfcn.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gpt.h"
+#include "process.h"
+#include "utility.h"
+
+using namespace std;
+
+// name of the kernel function in the shared object
+#define JIT_FUNCTION "gpt_kernel"
+
+bool jit_compile(osl_scop_p scop, const vector<long>& params,
+                 JitKernel& kernel, const string& cc, const string& cflags) {
+    jit_free(kernel);
+    if (!kernel_layout(scop, params, kernel.layout)) return false;
+    kernel.params = params;
+    kernel.shape = kernel_shape(kernel.layout);
+
+    char dir_template[] = "/tmp/gpt-jit-XXXXXX";
+    if (mkdtemp(dir_template) == NULL) {
+        perror("mkdtemp");
+        return false;
+    }
+    string dir = dir_template;
+    string code = print_scop_to_string(scop);
+    string source = dir + "/kernel.c", object = dir + "/kernel.so";
+
+    // cc and cflags may hold several words, e.g. "ccache gcc", "-O3 -g"
+    vector<string> build = split_words(cc);
+    for (auto& flag : split_words(cflags)) build.push_back(flag);
+    // the parallel loops only run in parallel with OpenMP enabled
+    if (has_omp_loops(scop)) build.push_back("-fopenmp");
+    for (auto arg : {"-shared", "-fPIC", "-o"}) build.push_back(arg);
+    build.push_back(object);
+    build.push_back(source);
+    build.push_back("-lm");
+
+    string text = kernel_prelude() +
+                  kernel_source(scop, kernel.layout, code, JIT_FUNCTION);
+    if (!write_file(source, text)) {
+        cerr << "jit: cannot write " << source << endl;
+    } else if (!run_program(build)) {
+        cerr << "jit: cannot compile " << source << endl;
+    } else {
+        kernel.handle = dlopen(object.c_str(), RTLD_NOW);
+        if (kernel.handle == NULL)
+            cerr << "jit: " << dlerror() << endl;
+        else
+            kernel.function = (void (*)(const long*, double**, const long*))
+                dlsym(kernel.handle, JIT_FUNCTION);
+    }
+    // the loaded object stays mapped once its file is gone
+    if (!remove_tree(dir)) cerr << "jit: cannot remove " << dir << endl;
+    if (kernel.function == NULL) jit_free(kernel);
+    return kernel.function != NULL;
+}
+
+vector<vector<double>> jit_arrays(const JitKernel& kernel) {
+    vector<vector<double>> arrays;
+    for (size_t k = 0; k < kernel.layout.arrays.size(); ++k) {
+        long size = kernel_array_size(kernel.layout.arrays[k]);
+        arrays.emplace_back(size + 1);
+        for (long i = 0; i < size; ++i)
+            arrays[k][i] = 1.0 + (double)((i * 7 + k * 13) % 101) / 101.0;
+    }
+    return arrays;
+}
+
+double jit_run(const JitKernel& kernel, vector<vector<double>>& arrays,
+               int reps) {
+    if (kernel.function == NULL ||
+        arrays.size() != kernel.layout.arrays.size())
+        return -1;
+    vector<double*> pointers;
+    for (auto& array : arrays) pointers.push_back(array.data());
+    pointers.push_back(NULL);
+
+    double best = -1;
+    for (int r = 0; r < max(reps, 1); ++r) {
+        auto start = chrono::steady_clock::now();
+        kernel.function(kernel.params.data(), pointers.data(),
+                        kernel.shape.data());
+        double seconds = chrono::duration<double>(
+                             chrono::steady_clock::now() - start)
+                             .count();
+        if (best < 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+void jit_free(JitKernel& kernel) {
+    if (kernel.handle != NULL) dlclose(kernel.handle);
+    kernel.handle = NULL;
+    kernel.function = NULL;
+}
@@ -0,0 +1,156 @@
+/* journal.cpp transactions on a SCoP: apply commands, then undo them
+ *
+ * before a command runs, what it may change is saved: the scattering and
+ * the domain of the statements under the loop it names (with the siblings
+ * it may shift), the scattering names and the osl_loop annotations;
+ * undoing it puts them back and drops the statements it added, so a search
+ * pays for the part of the scop it edits instead of a clone of all of it
+ */
+
+#include <vector>
+
+#include "gpt.h"
+#include "parser.h"
+#include "utility.h"
+
+using namespace std;
+
+// the statements a command may change are the ones under this prefix:
+// the loop it names and its siblings (fuse, distribute, index_set_split...
+// shift the loops after it), split shifts everything after the statement
+// from depth on
+static vector<int> command_prefix(const string& command) {
+    ArgList args;
+    int func = parser(command, args, false);
+    if (func == 0 || args.empty() || args[0]->type != 1) return {};
+    auto id = ((VectorArg*)args[0])->arg;
+    size_t length = id.empty() ? 0 : id.size() - 1;
+    if (func == SPLIT && args.size() > 1 && args[1]->type == 0)
+        length = min(length, (size_t)max(((SingleIntArg*)args[1])->arg - 1,
+                                         0));
+    id.resize(length);
+    return id;
+}
+
+static osl_scatnames_p scatnames(osl_scop_p scop) {
+    return (osl_scatnames_p)osl_generic_lookup(scop->extension,
+                                               OSL_URI_SCATNAMES);
+}
+
+static void save_step(osl_scop_p scop, const vector<int>& prefix,
+                      JournalStep& step) {
+    for (auto s = scop->statement; s != NULL; s = s->next) {
+        step.statements.push_back(s);
+        if (!in_loop(prefix, get_statementID(s->scattering))) continue;
+        step.saved.push_back(s);
+        step.scatterings.push_back(osl_relation_clone(s->scattering));
+        step.domains.push_back(osl_relation_clone(s->domain));
+    }
+    osl_scatnames_p scat = scatnames(scop);
+    if (scat != NULL && scat->names != NULL)
+        step.names = osl_strings_clone(scat->names);
+    osl_loop_p loop =
+        (osl_loop_p)osl_generic_lookup(scop->extension, OSL_URI_LOOP);
+    if (loop != NULL) step.loops = osl_loop_clone(loop);
+}
+
+// free the copies a step holds
+static void drop_step(JournalStep& step) {
+    for (auto r : step.scatterings) osl_relation_free(r);
+    for (auto r : step.domains) osl_relation_free(r);
+    if (step.names != NULL) osl_strings_free(step.names);
+    if (step.loops != NULL) osl_loop_free(step.loops);
+    step = JournalStep();
+}
+
+static void restore_step(osl_scop_p scop, JournalStep& step) {
+    // the commands only insert statements: the ones not in the saved list
+    // were added by the command
+    size_t k = 0;
+    for (auto s = scop->statement; s != NULL;) {
+        auto next = s->next;
+        if (k < step.statements.size() && s == step.statements[k]) {
+            ++k;
+        } else {
+            s->next = NULL;
+            osl_statement_free(s);
+        }
+        s = next;
+    }
+    auto& list = step.statements;
+    for (size_t i = 0; i + 1 < list.size(); ++i) list[i]->next = list[i + 1];
+    if (!list.empty()) list.back()->next = NULL;
+    scop->statement = list.empty() ? NULL : list[0];
+
+    for (size_t i = 0; i < step.saved.size(); ++i) {
+        osl_relation_free(step.saved[i]->scattering);
+        osl_relation_free(step.saved[i]->domain);
+        step.saved[i]->scattering = step.scatterings[i];
+        step.saved[i]->domain = step.domains[i];
+    }
+    step.scatterings.clear();
+    step.domains.clear();
+
+    osl_scatnames_p scat = scatnames(scop);
+    if (scat != NULL && step.names != NULL) {
+        osl_strings_free(scat->names);
+        scat->names = step.names;
+        step.names = NULL;
+    }
+
+    // the commands append loops (wavefront) and renumber the statements
+    // of the ones there are (the copies of unroll_jam, peel...)
+    if (osl_generic_lookup(scop->extension, OSL_URI_LOOP) != NULL)
+        osl_generic_remove(&scop->extension, OSL_URI_LOOP);
+    if (step.loops != NULL) {
+        osl_generic_add(&scop->extension,
+                        osl_generic_shell(step.loops, osl_loop_interface()));
+        step.loops = NULL;
+    }
+    drop_step(step);
+}
+
+ScopTransaction::~ScopTransaction() { transaction_commit(*this); }
+
+void transaction_begin(osl_scop_p scop, ScopTransaction& transaction) {
+    transaction_commit(transaction);
+    transaction.scop = scop;
+}
+
+int transaction_apply(ScopTransaction& transaction, const string& command,
+                      bool verbose) {
+    if (transaction.scop == NULL) return -1;
+    transaction.steps.emplace_back();
+    save_step(transaction.scop, command_prefix(command),
+              transaction.steps.back());
+    int ret = transformation(transaction.scop, command, verbose);
+    // a failed command may have changed part of the scop
+    if (ret != 0) transaction_undo(transaction);
+    return ret;
+}
+
+int transaction_apply_script(ScopTransaction& transaction,
+                             const string& script, bool verbose) {
+    for (auto command : split_script(script)) {
+        int ret = transaction_apply(transaction, command, verbose);
+        if (ret != 0) return ret;
+    }
+    return 0;
+}
+
+bool transaction_undo(ScopTransaction& transaction) {
+    if (transaction.steps.empty()) return false;
+    restore_step(transaction.scop, transaction.steps.back());
+    transaction.steps.pop_back();
+    return true;
+}
+
+void transaction_rollback(ScopTransaction& transaction) {
+    while (transaction_undo(transaction)) {
+    }
+}
+
+void transaction_commit(ScopTransaction& transaction) {
+    for (auto& step : transaction.steps) drop_step(step);
+    transaction.steps.clear();
+}
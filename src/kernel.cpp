@@ -0,0 +1,205 @@
+/* kernel.cpp wrap the code of a SCoP into a standalone C kernel
+ *
+ * the kernel has the signature
+ *   void name(const long* gpt_params, double** gpt_arrays,
+ *             const long* gpt_shape)
+ * gpt_params holds the parameter values in the order of the scop,
+ * gpt_arrays one pointer per array of the layout (scalars included), and
+ * gpt_shape, for each array in turn, its lower bounds then its extents
+ */
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "affine.h"
+#include "gpt.h"
+
+using namespace std;
+
+string kernel_prelude() {
+    return "#include <math.h>\n"
+           "#include <stdio.h>\n"
+           "#include <stdlib.h>\n"
+           "\n"
+           "#define floord(n, d) \\\n"
+           "  (((n) < 0) ? -((-(n) + (d) - 1) / (d)) : (n) / (d))\n"
+           "#define ceild(n, d) \\\n"
+           "  (((n) < 0) ? -((-(n)) / (d)) : ((n) + (d) - 1) / (d))\n"
+           "#define max(x, y) ((x) > (y) ? (x) : (y))\n"
+           "#define min(x, y) ((x) < (y) ? (x) : (y))\n"
+           "\n";
+}
+
+bool kernel_layout(osl_scop_p scop, const vector<long>& params,
+                   KernelLayout& layout) {
+    layout.params = parameter_names(scop);
+    layout.arrays.clear();
+    if (params.size() < layout.params.size()) {
+        cerr << "kernel: " << layout.params.size() << " parameters expected"
+             << endl;
+        return false;
+    }
+
+    for (auto s = scop->statement; s != NULL; s = s->next) {
+        vector<long long> lo, hi;
+        // a statement that never runs touches nothing
+        if (!domain_box(s->domain, params, lo, hi)) continue;
+
+        for (auto l = s->access; l != NULL; l = l->next) {
+            AccessFunction f;
+            if (!access_function(l->elt, f)) {
+                cerr << "kernel: non affine access in statement" << endl;
+                return false;
+            }
+
+            KernelArray* array = NULL;
+            for (auto& a : layout.arrays)
+                if (a.id == f.array) array = &a;
+            if (array == NULL) {
+                layout.arrays.push_back(KernelArray());
+                array = &layout.arrays.back();
+                array->id = f.array;
+                array->name = array_name(scop, f.array);
+                array->lower.assign(f.dims.size(), BOUND_INF);
+                array->extent.assign(f.dims.size(), 0);
+            }
+            if (array->lower.size() != f.dims.size()) {
+                cerr << "kernel: " << array->name << " used with two ranks"
+                     << endl;
+                return false;
+            }
+
+            // grow [lower, lower + extent) to hold the subscript interval
+            for (size_t d = 0; d < f.dims.size(); ++d) {
+                long long min_val, max_val;
+                if (!affine_interval(f.dims[d], lo, hi, params, min_val,
+                                     max_val)) {
+                    cerr << "kernel: unbounded subscript of " << array->name
+                         << endl;
+                    return false;
+                }
+                long long upper = array->lower[d] == BOUND_INF
+                                      ? max_val
+                                      : max(max_val, array->lower[d] +
+                                                         array->extent[d] - 1);
+                array->lower[d] = min(array->lower[d], min_val);
+                array->extent[d] = upper - array->lower[d] + 1;
+            }
+        }
+    }
+    return true;
+}
+
+// the iterators the code of the scop may use: the original ones, the
+// loop dimensions of the scattering and the bounds of the OpenMP loops
+static vector<string> kernel_iterators(osl_scop_p scop) {
+    set<string> seen;
+    vector<string> names;
+    for (auto s = scop->statement; s != NULL; s = s->next) {
+        osl_body_p body =
+            (osl_body_p)osl_generic_lookup(s->extension, OSL_URI_BODY);
+        if (body == NULL || body->iterators == NULL) continue;
+        for (char** it = body->iterators->string; *it != NULL; ++it)
+            if (seen.insert(*it).second) names.push_back(*it);
+    }
+    osl_scatnames_p scat = (osl_scatnames_p)osl_generic_lookup(
+        scop->extension, OSL_URI_SCATNAMES);
+    if (scat != NULL && scat->names != NULL) {
+        int nb_names = osl_strings_size(scat->names);
+        for (int i = 1; i < nb_names; i += 2)
+            if (seen.insert(scat->names->string[i]).second)
+                names.push_back(scat->names->string[i]);
+    }
+    if (has_omp_loops(scop))
+        for (auto name : {"lbp", "ubp"})
+            if (seen.insert(name).second) names.push_back(name);
+    return names;
+}
+
+string kernel_source(osl_scop_p scop, const KernelLayout& layout,
+                     const string& code, const string& name) {
+    string src;
+    src += "void " + name +
+           "(const long* gpt_params, double** gpt_arrays,\n"
+           "    const long* gpt_shape) {\n";
+    for (size_t p = 0; p < layout.params.size(); ++p)
+        src += "  const long " + layout.params[p] + " = gpt_params[" +
+               to_string(p) + "];\n";
+
+    vector<string> scalars;
+    int offset = 0;
+    for (size_t k = 0; k < layout.arrays.size(); ++k) {
+        auto& array = layout.arrays[k];
+        int rank = array.lower.size();
+        string base = "gpt_arrays[" + to_string(k) + "]";
+        if (rank == 0) {
+            src += "#define " + array.name + " (*" + base + ")\n";
+            scalars.push_back(array.name);
+            continue;
+        }
+
+        string shape = "gpt_s" + to_string(k);
+        src += "  const long* " + shape + " = gpt_shape + " +
+               to_string(offset) + ";\n";
+        auto lower = [&](int d) { return shape + "[" + to_string(d) + "]"; };
+        auto extent = [&](int d) {
+            return shape + "[" + to_string(rank + d) + "]";
+        };
+
+        // pointer to the element (0, ..., 0), in Horner form
+        string corner = lower(0);
+        for (int d = 1; d < rank; ++d)
+            corner = "(" + corner + ") * " + extent(d) + " + " + lower(d);
+        string type = "double (*" + array.name + ")";
+        string cast = "double (*)";
+        for (int d = 1; d < rank; ++d) {
+            type += "[" + extent(d) + "]";
+            cast += "[" + extent(d) + "]";
+        }
+        if (rank == 1)
+            src += "  double* " + array.name + " = " + base + " - " + corner +
+                   ";\n";
+        else
+            src += "  " + type + " =\n      (" + cast + ")(" + base + " - (" +
+                   corner + "));\n";
+        offset += 2 * rank;
+    }
+
+    auto iterators = kernel_iterators(scop);
+    if (!iterators.empty()) {
+        src += "  int " + iterators[0];
+        for (size_t i = 1; i < iterators.size(); ++i)
+            src += ", " + iterators[i];
+        src += ";\n";
+    }
+
+    size_t pos = 0;
+    while (pos < code.length()) {
+        size_t eol = code.find('\n', pos);
+        size_t next = eol == string::npos ? code.length() : eol + 1;
+        src += "  " + code.substr(pos, next - pos);
+        pos = next;
+    }
+    if (!src.empty() && src.back() != '\n') src += '\n';
+
+    for (auto& scalar : scalars) src += "#undef " + scalar + "\n";
+    src += "}\n";
+    return src;
+}
+
+vector<long> kernel_shape(const KernelLayout& layout) {
+    vector<long> shape;
+    for (auto& array : layout.arrays) {
+        shape.insert(shape.end(), array.lower.begin(), array.lower.end());
+        shape.insert(shape.end(), array.extent.begin(), array.extent.end());
+    }
+    return shape;
+}
+
+long kernel_array_size(const KernelArray& array) {
+    long size = 1;
+    for (auto e : array.extent) size *= max(e, 0LL);
+    return size;
+}
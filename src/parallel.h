@@ -0,0 +1,35 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// number of worker threads to use, jobs <= 0 means one per core
+inline int resolve_jobs(int jobs) {
+    if (jobs > 0) return jobs;
+    int cores = thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+// run fn(0) ... fn(n - 1) on at most jobs threads
+// the items are handed out dynamically, so uneven items balance out
+inline void parallel_for(int n, int jobs, function<void(int)> fn) {
+    jobs = min(resolve_jobs(jobs), n);
+    if (jobs <= 1) {
+        for (int i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    atomic<int> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < jobs; ++t)
+        workers.emplace_back([&]() {
+            for (int i = next++; i < n; i = next++) fn(i);
+        });
+    for (auto& worker : workers) worker.join();
+}
+
+#endif
@@ -16,6 +16,16 @@
 #define SKEW 5
 #define TILE 6
 #define UNROLL 7
+#define REVERSE 8
+#define UNROLL_JAM 9
+#define DISTRIBUTE 10
+#define PEEL 11
+#define INDEX_SET_SPLIT 12
+#define STRIPMINE 13
+#define WAVEFRONT 14
+#define SHIFT 15
+#define AUTOFUSE 16
+#define PERMUTE 17
 
 using namespace std;
 
@@ -43,9 +53,9 @@ class VectorArg : public BaseArg {
     }
 };
 
-bool isdigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isdigit(char c) { return c >= '0' && c <= '9'; }
 
-string get_trans(osl_generic_p extension) {
+inline string get_trans(osl_generic_p extension) {
     string arg;
     for (auto p = extension; p != NULL; p = p->next) {
         if (strcmp(p->interface->URI, "clay") == 0) {
@@ -55,7 +65,7 @@ string get_trans(osl_generic_p extension) {
     return arg;
 }
 
-SingleIntArg *read_int(string &str, int &p) {
+inline SingleIntArg *read_int(string &str, int &p) {
     while (p < str.length() && !isdigit(str[p]) && str[p] != '-') ++p;
 
     SingleIntArg *ret = new SingleIntArg();
@@ -76,7 +86,7 @@ SingleIntArg *read_int(string &str, int &p) {
     return ret;
 }
 
-VectorArg *read_vector(string &str, int &p) {
+inline VectorArg *read_vector(string &str, int &p) {
     VectorArg *ret = new VectorArg();
     while (p < str.length() && str[p] != ']') {
         while (p < str.length() && !isdigit(str[p]) && str[p] != '-' &&
@@ -90,16 +100,49 @@ VectorArg *read_vector(string &str, int &p) {
     return ret;
 }
 
-int parser(osl_scop_p scop, vector<BaseArg *> &args) {
-    string str = get_trans(scop->extension);
-    // some preprocessing
-    str.erase(0, str.find_first_not_of(" "));
-    str.erase(str.find(';'), str.length());
+// release the arguments filled by parser()
+inline void free_args(vector<BaseArg *> &args) {
+    for (auto ptr : args) {
+        if (ptr->type == 0)
+            delete (SingleIntArg *)ptr;
+        else
+            delete (VectorArg *)ptr;
+    }
+    args.clear();
+}
+
+// the arguments of one command, released with it on every path
+class ArgList : public vector<BaseArg *> {
+   public:
+    ArgList() {}
+    ArgList(const ArgList &) = delete;
+    ArgList &operator=(const ArgList &) = delete;
+    ~ArgList() { free_args(*this); }
+};
 
+// split a Clay script into its commands, one per ';'
+inline vector<string> split_script(string script) {
+    vector<string> commands;
+    size_t begin = 0;
+    while (begin < script.length()) {
+        size_t end = script.find(';', begin);
+        if (end == string::npos) end = script.length();
+        string command = script.substr(begin, end - begin);
+        command.erase(0, command.find_first_not_of(" \t\r\n"));
+        if (!command.empty()) commands.push_back(command);
+        begin = end + 1;
+    }
+    return commands;
+}
+
+// parse one command of the script, return the transformation id
+// or 0 if the name is unknown
+inline int parser(string str, vector<BaseArg *> &args, bool verbose) {
     string func_name = str.substr(0, str.find('('));
+    func_name.erase(func_name.find_last_not_of(" \t\r\n") + 1);
     int ret = 0;
 
-    cerr << "func_name: " << func_name << endl;
+    if (verbose) cerr << "func_name: " << func_name << endl;
 
     if (func_name == "split") {
         ret = SPLIT;
@@ -115,12 +158,32 @@ int parser(osl_scop_p scop, vector<BaseArg *> &args) {
         ret = TILE;
     } else if (func_name == "unroll") {
         ret = UNROLL;
+    } else if (func_name == "reverse") {
+        ret = REVERSE;
+    } else if (func_name == "unroll_jam") {
+        ret = UNROLL_JAM;
+    } else if (func_name == "distribute") {
+        ret = DISTRIBUTE;
+    } else if (func_name == "peel") {
+        ret = PEEL;
+    } else if (func_name == "index_set_split") {
+        ret = INDEX_SET_SPLIT;
+    } else if (func_name == "stripmine") {
+        ret = STRIPMINE;
+    } else if (func_name == "wavefront") {
+        ret = WAVEFRONT;
+    } else if (func_name == "shift") {
+        ret = SHIFT;
+    } else if (func_name == "autofuse") {
+        ret = AUTOFUSE;
+    } else if (func_name == "permute") {
+        ret = PERMUTE;
     } else {
         cerr << "Unknown transformation: " << func_name << endl;
-        exit(1);
+        return 0;
     }
 
-    args.clear();
+    free_args(args);
     int p = str.find('(') + 1;
 
     while (p < str.length()) {
@@ -0,0 +1,96 @@
+#ifndef POLYHEDRA_H
+#define POLYHEDRA_H
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <isl/ctx.h>
+#include <isl/set.h>
+#include <osl/osl.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "affine.h"
+
+using namespace std;
+
+// OpenScop relations written in the isl syntax: the iterators are i0,
+// i1, ..., the scattering dimensions o0, o1, ..., the local dimensions
+// l0, l1, ... and the parameters p0, p1, ...
+
+// "prefix0, prefix1, ..., prefix(n - 1)"
+inline string to_isl_names(const string& prefix, int n) {
+    string ret;
+    for (int k = 0; k < n; ++k) ret += (k ? ", " : "") + prefix + to_string(k);
+    return ret;
+}
+
+// the name of every column of a relation part between e/i and the constant,
+// the parameters are p0, p1... unless params names them
+inline vector<string> to_isl_columns(osl_relation_p part, bool scattering,
+                                     const vector<string>& params = {}) {
+    vector<string> names;
+    for (int d = 0; d < part->nb_output_dims; ++d)
+        names.push_back((scattering ? "o" : "i") + to_string(d));
+    for (int d = 0; d < part->nb_input_dims; ++d)
+        names.push_back("i" + to_string(d));
+    for (int d = 0; d < part->nb_local_dims; ++d)
+        names.push_back("l" + to_string(d));
+    for (int d = 0; d < part->nb_parameters; ++d)
+        names.push_back(params.empty() ? "p" + to_string(d) : params[d]);
+    return names;
+}
+
+// "c0*n0 + c1*n1 + k >= 0" (or "= 0") for a row of a relation part
+inline string to_isl_row(osl_relation_p part, int row,
+                         const vector<string>& names) {
+    string expr;
+    int constant_pos = part->nb_columns - 1;
+    for (int col = 1; col <= constant_pos; ++col) {
+        long long c = entry(part, row, col);
+        if (c == 0) continue;
+        if (expr.empty())
+            expr = c < 0 ? "-" : "";
+        else
+            expr += c < 0 ? " - " : " + ";
+        expr += to_string(llabs(c));
+        if (col < constant_pos) expr += "*" + names[col - 1];
+    }
+    if (expr.empty()) expr = "0";
+    return expr + (entry(part, row, 0) == 0 ? " = 0" : " >= 0");
+}
+
+// the rows of a relation part for which keep[row] holds (all of them if
+// keep is empty), joined by "and", inside "exists" when there are locals
+inline string to_isl_constraints(osl_relation_p part, bool scattering,
+                                 const vector<bool>& keep = {},
+                                 const vector<string>& params = {}) {
+    auto names = to_isl_columns(part, scattering, params);
+    string ret;
+    for (int row = 0; row < part->nb_rows; ++row) {
+        if (!keep.empty() && !keep[row]) continue;
+        if (!ret.empty()) ret += " and ";
+        ret += to_isl_row(part, row, names);
+    }
+    if (part->nb_local_dims > 0)
+        ret = "exists (" + to_isl_names("l", part->nb_local_dims) + ": " +
+              (ret.empty() ? "true" : ret) + ")";
+    return ret;
+}
+
+// a relation part as an isl set over all its output and input dimensions
+inline isl_set* to_isl_set(isl_ctx* ctx, osl_relation_p part,
+                           bool scattering, const vector<bool>& keep = {}) {
+    string tuple = to_isl_names(scattering ? "o" : "i", part->nb_output_dims);
+    if (part->nb_input_dims > 0)
+        tuple += (tuple.empty() ? "" : ", ") +
+                 to_isl_names("i", part->nb_input_dims);
+    string constraints = to_isl_constraints(part, scattering, keep);
+    string text = "[" + to_isl_names("p", part->nb_parameters) + "] -> { [" +
+                  tuple + "]" +
+                  (constraints.empty() ? "" : " : " + constraints) + " }";
+    return isl_set_read_from_str(ctx, text.c_str());
+}
+
+#endif
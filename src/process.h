@@ -0,0 +1,109 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern char** environ;
+
+using namespace std;
+
+// the C compiler and the programs it builds, run by jit.cpp and bench.cpp:
+// every program gets its arguments as an argv array, never through the
+// shell, so the paths and flags reach it as they are
+
+// the words of an option such as --cflags "-O3 -march=native", split at
+// blanks (there is no quoting)
+inline vector<string> split_words(const string& text) {
+    vector<string> words;
+    size_t start = text.find_first_not_of(" \t\n");
+    while (start != string::npos) {
+        size_t stop = text.find_first_of(" \t\n", start);
+        words.push_back(text.substr(start, stop - start));
+        start = text.find_first_not_of(" \t\n", stop);
+    }
+    return words;
+}
+
+// run args[0] (searched in PATH) and wait for it, with its standard output
+// in output if not NULL
+// return true if it exits with status 0
+inline bool run_program(const vector<string>& args, string* output = NULL) {
+    if (args.empty()) return false;
+    vector<char*> argv;
+    for (auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(NULL);
+
+    int fds[2] = {-1, -1};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (output != NULL) {
+        // close on exec, so that no other child keeps the pipe open
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            perror("pipe");
+            posix_spawn_file_actions_destroy(&actions);
+            return false;
+        }
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    }
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv.data(),
+                           environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (output != NULL) close(fds[1]);
+    if (err != 0) {
+        cerr << "cannot run " << args[0] << ": " << strerror(err) << endl;
+        if (output != NULL) close(fds[0]);
+        return false;
+    }
+
+    if (output != NULL) {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(fds[0], buffer, sizeof(buffer))) != 0) {
+            if (n > 0)
+                output->append(buffer, n);
+            else if (errno != EINTR)
+                break;
+        }
+        close(fds[0]);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// write text to the file at path
+// return false if the file cannot be written completely
+inline bool write_file(const string& path, const string& text) {
+    ofstream out(path);
+    out << text;
+    out.close();
+    return !out.fail();
+}
+
+// nftw callback of remove_tree(): the children come before their directory
+inline int remove_entry(const char* path, const struct stat*, int,
+                        struct FTW*) {
+    return remove(path) == 0 ? 0 : -1;
+}
+
+// remove the directory dir and everything under it, without following
+// the symbolic links
+inline bool remove_tree(const string& dir) {
+    return nftw(dir.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+}
+
+#endif
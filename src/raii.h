@@ -0,0 +1,137 @@
+#ifndef RAII_H
+#define RAII_H
+
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+// owners of the C objects of osl, CLooG and libc: the object is freed
+// when its owner goes out of scope, on the error paths too, and every
+// kind of object is counted so that a long run can check that nothing
+// stays alive from one job to the next
+
+enum OwnedKind { OWN_SCOP, OWN_RELATION, OWN_STRINGS, OWN_STRING, OWN_FILE,
+                 OWN_CLOOG, OWN_KINDS };
+
+struct OwnedCount {
+    atomic<long> live{0};   // objects owned right now
+    atomic<long> total{0};  // objects ever owned
+};
+
+inline OwnedCount owned_counts[OWN_KINDS];
+
+inline void free_string(char* str) { free(str); }
+inline void close_file(FILE* file) { fclose(file); }
+
+template <typename T, void (*Free)(T*), OwnedKind Kind>
+class Owned {
+   public:
+    Owned() {}
+    explicit Owned(T* ptr) { reset(ptr); }
+    Owned(Owned&& other) : ptr(other.ptr) { other.ptr = NULL; }
+    Owned& operator=(Owned&& other) {
+        if (this != &other) {
+            reset();
+            ptr = other.ptr;
+            other.ptr = NULL;
+        }
+        return *this;
+    }
+    Owned(const Owned&) = delete;
+    Owned& operator=(const Owned&) = delete;
+    ~Owned() { reset(); }
+
+    T* get() const { return ptr; }
+    T* operator->() const { return ptr; }
+    explicit operator bool() const { return ptr != NULL; }
+
+    // free the object owned so far and take ptr
+    void reset(T* other = NULL) {
+        if (other == ptr) return;
+        if (ptr != NULL) {
+            Free(ptr);
+            --owned_counts[Kind].live;
+        }
+        ptr = other;
+        if (ptr != NULL) {
+            ++owned_counts[Kind].live;
+            ++owned_counts[Kind].total;
+        }
+    }
+
+    // give the object to a C structure or a caller that frees it
+    T* release() {
+        T* ret = ptr;
+        if (ptr != NULL) --owned_counts[Kind].live;
+        ptr = NULL;
+        return ret;
+    }
+
+   private:
+    T* ptr = NULL;
+};
+
+typedef Owned<struct osl_scop, osl_scop_free, OWN_SCOP> OwnedScop;
+typedef Owned<struct osl_relation, osl_relation_free, OWN_RELATION>
+    OwnedRelation;
+typedef Owned<struct osl_strings, osl_strings_free, OWN_STRINGS>
+    OwnedStrings;
+typedef Owned<char, free_string, OWN_STRING> OwnedString;
+typedef Owned<FILE, close_file, OWN_FILE> OwnedFile;
+
+// a copy of scop alone, without the scops that follow it
+inline OwnedScop clone_scop(osl_scop_p scop) {
+    OwnedScop copy(osl_scop_clone(scop));
+    osl_scop_free(copy->next);
+    copy->next = NULL;
+    return copy;
+}
+
+// a CLooG state with its options, the scop given to the options is
+// owned by the caller and not freed with them
+class CloogSession {
+   public:
+    CloogSession() {
+        state = cloog_state_malloc();
+        options = cloog_options_malloc(state);
+        ++owned_counts[OWN_CLOOG].live;
+        ++owned_counts[OWN_CLOOG].total;
+    }
+    CloogSession(const CloogSession&) = delete;
+    CloogSession& operator=(const CloogSession&) = delete;
+    ~CloogSession() {
+        options->scop = NULL;
+        cloog_options_free(options);
+        cloog_state_free(state);
+        --owned_counts[OWN_CLOOG].live;
+    }
+
+    CloogState* state;
+    CloogOptions* options;
+};
+
+// the owned objects still alive and the bytes the heap hands out
+inline void print_allocation_report(FILE* output) {
+    static const char* names[OWN_KINDS] = {"scops",  "relations", "strings",
+                                           "string", "files",     "cloog"};
+    fprintf(output, "allocations:\n");
+    for (int k = 0; k < OWN_KINDS; ++k)
+        fprintf(output, "  %-10s live %-8ld total %ld\n", names[k],
+                owned_counts[k].live.load(), owned_counts[k].total.load());
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+    fprintf(output, "  heap in use %zu bytes\n", mallinfo2().uordblks);
+#endif
+#endif
+}
+
+#endif
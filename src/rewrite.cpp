@@ -0,0 +1,142 @@
+/* rewrite.cpp source-to-source rewriting of the SCoP regions of a C file */
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gpt.h"
+#include "parallel.h"
+#include "raii.h"
+#include "utility.h"
+
+using namespace std;
+
+// match "#pragma <word>" on a line, blanks are allowed around '#'
+static bool is_pragma(const string& line, const char* word) {
+    size_t p = line.find_first_not_of(" \t");
+    if (p == string::npos || line[p] != '#') return false;
+    p = line.find_first_not_of(" \t", p + 1);
+    if (p == string::npos || line.compare(p, 6, "pragma") != 0) return false;
+    p = line.find_first_not_of(" \t", p + 6);
+    if (p == string::npos) return false;
+    size_t end = line.find_first_of(" \t\r\n", p);
+    if (end == string::npos) end = line.length();
+    return line.compare(p, end - p, word) == 0;
+}
+
+vector<ScopRegion> find_scop_regions(const string& source) {
+    vector<ScopRegion> regions;
+    ScopRegion region;
+    bool inside = false;
+    size_t pos = 0;
+    while (pos < source.length()) {
+        size_t eol = source.find('\n', pos);
+        size_t next = eol == string::npos ? source.length() : eol + 1;
+        string line = source.substr(pos, next - pos);
+        if (!inside && is_pragma(line, "scop")) {
+            inside = true;
+            region.begin = pos;
+            region.body = next;
+            region.indent = line.substr(0, line.find_first_not_of(" \t"));
+        } else if (inside && is_pragma(line, "endscop")) {
+            inside = false;
+            region.body_end = pos;
+            region.end = next;
+            regions.push_back(region);
+        }
+        pos = next;
+    }
+    return regions;
+}
+
+// loop iterators introduced by the transformations, the original ones
+// are already declared by the surrounding code
+static vector<string> new_iterators(osl_scop_p scop) {
+    set<string> original;
+    for (auto s = scop->statement; s != NULL; s = s->next) {
+        osl_body_p body = (osl_body_p)osl_generic_lookup(s->extension,
+                                                         OSL_URI_BODY);
+        if (body == NULL || body->iterators == NULL) continue;
+        for (char** it = body->iterators->string; *it != NULL; ++it)
+            original.insert(*it);
+    }
+
+    vector<string> names;
+    if (has_omp_loops(scop)) names = {"lbp", "ubp"};
+    osl_scatnames_p scat = (osl_scatnames_p)osl_generic_lookup(
+        scop->extension, OSL_URI_SCATNAMES);
+    if (scat == NULL || scat->names == NULL) return names;
+    int nb_names = osl_strings_size(scat->names);
+    // only the odd scattering dimensions are loops
+    for (int i = 1; i < nb_names; i += 2)
+        if (!original.count(scat->names->string[i]))
+            names.push_back(scat->names->string[i]);
+    return names;
+}
+
+// prefix every non-empty line of the code with indent
+static string indent_code(const string& code, const string& indent) {
+    string ret;
+    size_t pos = 0;
+    while (pos < code.length()) {
+        size_t eol = code.find('\n', pos);
+        size_t next = eol == string::npos ? code.length() : eol + 1;
+        if (next - pos > 1) ret += indent;
+        ret += code.substr(pos, next - pos);
+        pos = next;
+    }
+    if (!ret.empty() && ret.back() != '\n') ret += '\n';
+    return ret;
+}
+
+int rewrite_source(const string& source, const char* name, string& result,
+                   int jobs, const string& cache_dir) {
+    auto regions = find_scop_regions(source);
+    result = source;
+    if (regions.empty()) return 0;
+
+    OwnedScop owned(cache_dir.empty()
+                        ? read_scop_from_string(source, name)
+                        : read_scop_from_string_cached(source, name,
+                                                       cache_dir));
+    osl_scop_p scop = owned.get();
+    int nb_scops = 0;
+    for (auto s = scop; s != NULL; s = s->next) ++nb_scops;
+    if (nb_scops != (int)regions.size()) {
+        cerr << name << ": " << regions.size() << " scop regions but "
+             << nb_scops << " scops extracted" << endl;
+        return -1;
+    }
+
+    int failed = apply_clay_all(scop, jobs);
+    auto code = print_scops_to_strings(scop, jobs);
+
+    result.clear();
+    size_t pos = 0;
+    auto s = scop;
+    for (size_t i = 0; i < regions.size(); ++i, s = s->next) {
+        auto& region = regions[i];
+        const string& indent = region.indent;
+        result += source.substr(pos, region.body - pos);
+
+        auto names = new_iterators(s);
+        if (names.empty()) {
+            result += indent_code(code[i], indent);
+        } else {
+            result += indent + "{\n";
+            result += indent + "  int " + names[0];
+            for (size_t k = 1; k < names.size(); ++k)
+                result += ", " + names[k];
+            result += ";\n";
+            result += indent_code(code[i], indent + "  ");
+            result += indent + "}\n";
+        }
+
+        // keep the "#pragma endscop" line
+        result += source.substr(region.body_end, region.end - region.body_end);
+        pos = region.end;
+    }
+    result += source.substr(pos);
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,176 @@
+/* scop_cache.cpp extract the SCoPs of a C file region by region, with a
+ * cache of the Clan results
+ *
+ * every "#pragma scop" region is handed to Clan alone; the scop it gives,
+ * without its clay extension, is written as a binary scop named after an
+ * FNV-1a hash of the region text once normalized (Clay comment removed,
+ * trailing blanks and blank lines dropped), so that editing a Clay script
+ * or another region does not run Clan again on the unchanged ones
+ *
+ * the entry starts with the cache version and the normalized text, a
+ * stale entry or a hash collision is read back only if they match
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gpt.h"
+#include "raii.h"
+
+using namespace std;
+
+// bumped when the cached scops change shape
+#define SCOP_CACHE_VERSION "gpt-scop-cache 2\n"
+
+// the "/* Clay ... */" comment of a region: [begin, end) in body, and the
+// script inside it; false if there is none
+static bool find_clay(const string& body, size_t& begin, size_t& end,
+                      string& script) {
+    for (size_t p = body.find("/*"); p != string::npos;
+         p = body.find("/*", p + 2)) {
+        size_t word = body.find_first_not_of(" \t\r\n", p + 2);
+        if (word == string::npos || body.compare(word, 4, "Clay") != 0)
+            continue;
+        size_t close = body.find("*/", word + 4);
+        if (close == string::npos) return false;
+        begin = p;
+        end = close + 2;
+        script = body.substr(word + 4, close - word - 4);
+        return true;
+    }
+    return false;
+}
+
+// the region text the cache key is computed from
+static string normalize_region(const string& body) {
+    string text = body;
+    size_t begin, end;
+    string script;
+    if (find_clay(text, begin, end, script)) text.erase(begin, end - begin);
+
+    string normalized;
+    size_t pos = 0;
+    while (pos < text.length()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == string::npos) eol = text.length();
+        string line = text.substr(pos, eol - pos);
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty()) normalized += line + "\n";
+        pos = eol + 1;
+    }
+    return normalized;
+}
+
+unsigned long long scop_region_hash(const string& text) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned char c : string(SCOP_CACHE_VERSION) + text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// what a cache entry starts with, before the binary scop
+static string entry_header(const string& region) {
+    return SCOP_CACHE_VERSION + to_string(region.length()) + "\n" + region;
+}
+
+// whether input starts with header, the binary scop follows
+static bool read_header(FILE* input, const string& header) {
+    string text(header.length(), '\0');
+    return fread(&text[0], 1, text.length(), input) == text.length() &&
+           text == header;
+}
+
+// the scop of one region, from the cache or from Clan, without clay
+static osl_scop_p region_scop(const string& body, const char* input_name,
+                              const string& cache_dir) {
+    string region = normalize_region(body);
+    string header = entry_header(region);
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx", scop_region_hash(region));
+    string path = cache_dir + "/" + key + ".bscop";
+
+    OwnedFile cached(fopen(path.c_str(), "rb"));
+    if (cached && read_header(cached.get(), header)) {
+        OwnedScop scop(read_scop_binary(cached.get()));
+        if (scop && scop->next == NULL) return scop.release();
+    }
+
+    OwnedScop scop(read_scop_from_string(
+        "#pragma scop\n" + body + "#pragma endscop\n", input_name));
+    if (!scop || scop->next != NULL) return NULL;
+    if (osl_generic_lookup(scop->extension, OSL_URI_CLAY) != NULL)
+        osl_generic_remove(&scop->extension, OSL_URI_CLAY);
+
+    // written apart then renamed, a concurrent reader sees all or nothing
+    string temporary = path + "." + to_string(getpid());
+    OwnedFile output(fopen(temporary.c_str(), "wb"));
+    if (output) {
+        bool written =
+            fwrite(header.data(), 1, header.length(), output.get()) ==
+                header.length() &&
+            write_scop_binary(output.get(), scop.get()) == 0;
+        output.reset();
+        if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+            remove(temporary.c_str());
+    }
+    return scop.release();
+}
+
+// the cached scop was extracted from the region alone, with another name
+static void place_region(osl_scop_p scop, const string& body,
+                         const char* input_name, int first_line) {
+    size_t begin, end;
+    string script;
+    if (find_clay(body, begin, end, script)) {
+        osl_clay_p clay = osl_clay_malloc();
+        clay->script = strdup(script.c_str());
+        osl_generic_add(&scop->extension,
+                        osl_generic_shell(clay, osl_clay_interface()));
+    }
+
+    osl_coordinates_p coordinates = (osl_coordinates_p)osl_generic_lookup(
+        scop->extension, OSL_URI_COORDINATES);
+    if (coordinates != NULL) {
+        free(coordinates->name);
+        coordinates->name = strdup(input_name);
+        coordinates->line_start += first_line - 1;
+        coordinates->line_end += first_line - 1;
+    }
+}
+
+osl_scop_p read_scop_from_string_cached(const string& source,
+                                        const char* input_name,
+                                        const string& cache_dir) {
+    auto regions = find_scop_regions(source);
+    mkdir(cache_dir.c_str(), 0755);  // may exist already
+    OwnedScop head;
+    osl_scop_p tail = NULL;
+    size_t line_pos = 0;
+    int line = 1;
+    for (auto& region : regions) {
+        for (; line_pos < region.begin; ++line_pos)
+            if (source[line_pos] == '\n') ++line;
+        string body =
+            source.substr(region.body, region.body_end - region.body);
+        osl_scop_p scop = region_scop(body, input_name, cache_dir);
+        if (scop == NULL) {
+            // Clan may need the file as a whole
+            return read_scop_from_string(source, input_name);
+        }
+        place_region(scop, body, input_name, line);
+        if (tail == NULL)
+            head.reset(scop);
+        else
+            tail->next = scop;
+        tail = scop;
+    }
+    return head.release();
+}
@@ -0,0 +1,115 @@
+/* simplify.cpp clean the relations of a SCoP before code generation
+ *
+ * isl decides which rows of a domain or a scattering the other rows imply
+ * (the bounds stripmine() adds, rows several transformations duplicate)
+ * and which statements can never run: both are removed, so that CLooG
+ * projects and separates smaller polyhedra
+ */
+
+#include <isl/ctx.h>
+#include <isl/set.h>
+
+#include <vector>
+
+#include "gpt.h"
+#include "polyhedra.h"
+#include "utility.h"
+
+using namespace std;
+
+// remove the rows of a relation part the other rows imply
+// the rows on local dimensions are kept, they only make sense together
+static int remove_redundant_rows(isl_ctx* ctx, osl_relation_p part,
+                                 bool scattering) {
+    int first_local = 1 + part->nb_output_dims + part->nb_input_dims;
+    vector<bool> keep(part->nb_rows, true);
+    int removed = 0;
+    for (int row = part->nb_rows - 1; row >= 0; --row) {
+        bool local = false;
+        for (int l = 0; l < part->nb_local_dims; ++l)
+            local |= entry(part, row, first_local + l) != 0;
+        if (local) continue;
+
+        keep[row] = false;
+        vector<bool> alone(part->nb_rows, false);
+        alone[row] = true;
+        isl_set* others = to_isl_set(ctx, part, scattering, keep);
+        isl_set* bound = to_isl_set(ctx, part, scattering, alone);
+        bool implied = others != NULL && bound != NULL &&
+                       isl_set_is_subset(others, bound) == 1;
+        isl_set_free(others);
+        isl_set_free(bound);
+        if (implied)
+            ++removed;
+        else
+            keep[row] = true;
+    }
+    for (int row = part->nb_rows - 1; row >= 0; --row)
+        if (!keep[row]) osl_relation_remove_row(part, row);
+    return removed;
+}
+
+static bool empty_part(isl_ctx* ctx, osl_relation_p part) {
+    isl_set* set = to_isl_set(ctx, part, false);
+    bool empty = set != NULL && isl_set_is_empty(set) == 1;
+    isl_set_free(set);
+    return empty;
+}
+
+// drop the empty parts of a domain, return false if they all are
+static bool live_domain(isl_ctx* ctx, osl_relation_p* domain) {
+    bool live = false;
+    for (osl_relation_p* link = domain; *link != NULL;) {
+        osl_relation_p part = *link;
+        if (!empty_part(ctx, part)) {
+            live = true;
+            link = &part->next;
+        } else if (part->next != NULL || link != domain) {
+            // keep the last part of a dead domain
+            *link = part->next;
+            part->next = NULL;
+            osl_relation_free(part);
+        } else {
+            link = &part->next;
+        }
+    }
+    return live;
+}
+
+int simplify_scop(osl_scop_p scop) {
+    isl_ctx* ctx = isl_ctx_alloc();
+    int removed = 0;
+
+    // the statements that can never run, unless no statement would be left
+    vector<bool> dead;
+    bool any_live = false;
+    for (auto s = scop->statement; s != NULL; s = s->next) {
+        dead.push_back(s->domain != NULL && !live_domain(ctx, &s->domain));
+        any_live |= !dead.back();
+    }
+    vector<int> number;  // new number of each statement, 0 if removed
+    int kept = 0, k = 0;
+    for (osl_statement_p* link = &scop->statement; *link != NULL; ++k) {
+        osl_statement_p s = *link;
+        if (dead[k] && any_live) {
+            *link = s->next;
+            s->next = NULL;
+            osl_statement_free(s);
+            number.push_back(0);
+            ++removed;
+            continue;
+        }
+        number.push_back(++kept);
+        for (auto part = s->domain; part != NULL; part = part->next)
+            removed += remove_redundant_rows(ctx, part, false);
+        for (auto part = s->scattering; part != NULL; part = part->next)
+            removed += remove_redundant_rows(ctx, part, true);
+        link = &s->next;
+    }
+
+    // the loop annotations refer to the statements by number
+    renumber_loops(scop, number);
+
+    isl_ctx_free(ctx);
+    return removed;
+}
@@ -0,0 +1,1008 @@
+/* transform.cpp the Clay transformations on the scattering of a SCoP */
+
+#include <clan/clan.h>
+#include <cloog/cloog.h>
+#include <osl/osl.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "compose.h"
+#include "dependence.h"
+#include "gpt.h"
+#include "raii.h"
+#include "utility.h"
+
+using namespace std;
+
+int split(osl_scop_p scop, std::vector<int> statementID, unsigned int depth) {
+    statement_shift(scop->statement, statementID, depth);
+    return 0;
+}
+
+// the loopID represents a unique loop (or a node in the AST)
+// if the loopID is empty, then the whole scop is reordered
+int reorder(osl_scop_p scop, std::vector<int> loopID,
+            std::vector<int> neworder) {
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id1 = get_statementID(statement->scattering);
+        // check if the statement is in the loop
+        if (in_loop(loopID, id1)) {
+            // the position to be modified
+            int index = loopID.size();
+            // old order
+            int old_order = id1[index];
+            // new order
+            int new_order = neworder[old_order];
+            statement_id_modify(statement, index, new_order);
+        }
+    }
+    return 0;
+}
+
+// just swap the depth_1 loop column and depth_2 loop column
+int interchange(osl_scop_p scop, std::vector<int> loopID, unsigned int depth_1,
+                unsigned int depth_2, int pretty) {
+    if (depth_1 == depth_2) return 0;
+    // get the index in scattering matrix
+    int idx1 = depth_1 * 2 - 1;
+    int idx2 = depth_2 * 2 - 1;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id1 = get_statementID(statement->scattering);
+        if (in_loop(loopID, id1)) {
+            // swap the column idx1 and idx2: an osl_int_t holds the value,
+            // or a pointer to it in MP, so swapping the unions is exact in
+            // every precision and needs no call per entry
+            auto m = statement->scattering->m;
+            for (int row = 0; row < statement->scattering->nb_rows; row++)
+                swap(m[row][idx1 + 1], m[row][idx2 + 1]);
+        }
+    }
+
+    if (pretty) {
+        osl_strings_p names = ((osl_scatnames_p)osl_generic_lookup(
+                                   scop->extension, OSL_URI_SCATNAMES))
+                                  ->names;
+        swap(names->string[idx1], names->string[idx2]);
+    }
+
+    return 0;
+}
+
+// move the statements of next_loop_id into loopID, after its statements
+static void fuse_loops(osl_scop_p scop, const vector<int>& loopID,
+                       const vector<int>& next_loop_id) {
+    int fuse_val = loopID.back();
+    auto max_id = find_max_in_loop(scop, loopID);
+    int base_val = max_id[loopID.size()];
+
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto statement_id = get_statementID(statement->scattering);
+        if (in_loop(next_loop_id, statement_id)) {
+            // change the level
+            statement_id_modify(statement, loopID.size() - 1, fuse_val);
+
+            // cat the statement behind the max id
+            statement_id_add(statement, loopID.size(), base_val + 1);
+        }
+    }
+}
+
+// fuse means to merge two loops into one
+int fuse(osl_scop_p scop, std::vector<int> loopID) {
+    // check whether the loopID is valid
+    if (!check_is_loop(scop, loopID)) return -1;
+
+    vector<int> next_loop_id = get_next_loop(scop, loopID);
+    // if there is no next loop to fuse
+    if (next_loop_id.empty()) return -1;
+
+    fuse_loops(scop, loopID, next_loop_id);
+    return 0;
+}
+
+int skew(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+         unsigned int depth_other, int coeff) {
+    int idx1 = depth * 2 - 1;
+    int idx2 = depth_other * 2 - 1;
+
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto scattering = statement->scattering;
+        auto precision = scattering->precision;
+        auto statement_id = get_statementID(scattering);
+        if (!in_loop(loopID, statement_id)) continue;
+
+        // every row should be transformed !!!
+        osl_int_t t;
+        osl_int_init(precision, &t);
+        for (int row = 0; row < scattering->nb_rows; ++row) {
+            osl_int_mul_si(precision, &t, scattering->m[row][idx1 + 1], coeff);
+            osl_int_add(precision, &scattering->m[row][idx2 + 1],
+                        scattering->m[row][idx2 + 1], t);
+        }
+        osl_int_clear(precision, &t);
+    }
+
+    return 0;
+}
+
+// reverse the iteration order of the loop at depth: negate its column
+int reverse(osl_scop_p scop, std::vector<int> loopID, unsigned int depth) {
+    int idx = depth * 2 - 1;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto scattering = statement->scattering;
+        auto statement_id = get_statementID(scattering);
+        if (in_loop(loopID, statement_id)) {
+            for (int row = 0; row < scattering->nb_rows; ++row)
+                osl_int_oppose(scattering->precision,
+                               &scattering->m[row][idx + 1],
+                               scattering->m[row][idx + 1]);
+        }
+    }
+    return 0;
+}
+
+// retime the statements of statementID: c' = c + amount for the loop at
+// depth, amount holds the coefficient of every parameter and the constant,
+// or the constant alone
+int shift(osl_scop_p scop, std::vector<int> statementID, unsigned int depth,
+          std::vector<int> amount) {
+    if (depth < 1 || amount.empty()) return -1;
+    int col = depth * 2 - 1;
+
+    // check every statement before changing any
+    vector<osl_relation_p> matched;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto scattering = statement->scattering;
+        if (!in_loop(statementID, get_statementID(scattering))) continue;
+        int params = scattering->nb_parameters;
+        if (col >= scattering->nb_output_dims ||
+            (amount.size() != 1 && (int)amount.size() != params + 1)) {
+            cerr << "shift: no loop at depth " << depth
+                 << " or wrong number of coefficients" << endl;
+            return -1;
+        }
+        matched.push_back(scattering);
+    }
+    if (matched.empty()) return -1;
+
+    for (auto scattering : matched) {
+        // a * c = a * c' - a * amount in every row
+        int precision = scattering->precision;
+        int constant_pos = scattering->nb_columns - 1;
+        int params_pos = constant_pos - scattering->nb_parameters;
+        osl_int_t t;
+        osl_int_init(precision, &t);
+        for (int row = 0; row < scattering->nb_rows; ++row) {
+            auto m = scattering->m[row];
+            for (size_t k = 0; k < amount.size(); ++k) {
+                int pos = k + 1 == amount.size() ? constant_pos
+                                                 : params_pos + (int)k;
+                osl_int_mul_si(precision, &t, m[col + 1], -amount[k]);
+                osl_int_add(precision, &m[pos], m[pos], t);
+            }
+        }
+        osl_int_clear(precision, &t);
+    }
+    return 0;
+}
+
+// stripmine the loop at depth alone, without the interchange of tile()
+// with lanes the size is rounded up to a multiple of lanes (a size of 0
+// gives one register), the strips start at multiples of the size
+int strip_mine(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+               unsigned int size, unsigned int lanes) {
+    if (lanes > 0) size = max(1u, (size + lanes - 1) / lanes) * lanes;
+    if (size < 1 || depth < 1 || depth < loopID.size()) return -1;
+    bool found = false;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        if (!in_loop(loopID, get_statementID(statement->scattering)))
+            continue;
+        // every statement of loopID must be inside the loop at depth
+        if ((int)depth * 2 - 1 >= statement->scattering->nb_output_dims)
+            return -1;
+        found = true;
+    }
+    if (!found) return -1;
+    return stripmine(scop, loopID, depth, size);
+}
+
+int tile(osl_scop_p scop, std::vector<int> loop_id, unsigned int depth,
+         unsigned int depth_outer, unsigned int size) {
+    if (stripmine(scop, loop_id, depth, size) != 0) return -1;
+    // update the lood_id
+    vector<int> new_loop_id = loop_id;
+    new_loop_id.push_back(0);
+    for (int i = depth; i < loop_id.size(); ++i)
+        new_loop_id.push_back(loop_id[i]);
+    interchange(scop, new_loop_id, depth, depth_outer, 1);
+    return 0;
+}
+
+// the statementIDs of the loop body keep their order, the copies share
+// the inner loops (jam) and the statements of a body are ordered copy
+// after copy, so every copy sees its own iteration as before
+static void jam_copy(osl_statement_p statement, const vector<int>& id,
+                     unsigned int depth, unsigned int factor, int k,
+                     map<vector<int>, set<int>>& loops,
+                     map<vector<int>, int>& leaf_max) {
+    substitute_dim(statement->scattering, depth * 2 - 1, factor, k);
+    for (size_t l = depth; l < id.size(); ++l) {
+        vector<int> prefix(id.begin(), id.begin() + l);
+        if (l + 1 < id.size()) {
+            statement_id_modify(statement, l, id[l] * factor);
+            continue;
+        }
+        // the run [r0, r1] of statements between two sibling loops
+        int r0 = 0, r1 = leaf_max[prefix];
+        for (auto v : loops[prefix]) {
+            if (v < id[l]) r0 = max(r0, v + 1);
+            if (v > id[l]) r1 = min(r1, v - 1);
+        }
+        statement_id_modify(statement, l,
+                            r0 * factor + k * (r1 - r0 + 1) + id[l] - r0);
+    }
+}
+
+// unroll the loop at depth by factor and jam the copies into its body
+// copy k of a statement runs the iterations c = factor * c' + k, so the
+// remainder iterations (when factor does not divide the trip count) are
+// the ones only the first copies have, CLooG guards them
+int unroll_jam(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+               unsigned int factor) {
+    if (factor < 1 || depth < 1 || depth < loopID.size()) return -1;
+    if (factor == 1) return 0;
+    int col = depth * 2 - 1;
+
+    // the statements inside the loop and the shape of its body
+    vector<osl_statement_p> body;
+    map<vector<int>, set<int>> loops;  // loop statementIDs under a prefix
+    map<vector<int>, int> leaf_max;    // last statement under a prefix
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id = get_statementID(statement->scattering);
+        if (!in_loop(loopID, id) ||
+            col >= statement->scattering->nb_output_dims)
+            continue;
+        body.push_back(statement);
+        for (size_t l = depth; l < id.size(); ++l) {
+            vector<int> prefix(id.begin(), id.begin() + l);
+            if (l + 1 < id.size())
+                loops[prefix].insert(id[l]);
+            else if (!leaf_max.count(prefix) || leaf_max[prefix] < id[l])
+                leaf_max[prefix] = id[l];
+        }
+    }
+    if (body.empty()) return -1;
+
+    auto before = statement_list(scop);
+    map<osl_statement_p, osl_statement_p> origin;
+    for (auto statement : body) {
+        auto id = get_statementID(statement->scattering);
+        // the copies follow the original in the statement list
+        auto last = statement;
+        for (unsigned int k = 1; k < factor; ++k) {
+            osl_statement_p copy = osl_statement_nclone(statement, 1);
+            jam_copy(copy, id, depth, factor, k, loops, leaf_max);
+            copy->next = last->next;
+            last->next = copy;
+            last = copy;
+            origin[copy] = statement;
+        }
+        jam_copy(statement, id, depth, factor, 0, loops, leaf_max);
+    }
+    renumber_copies(scop, before, origin);
+    return 0;
+}
+
+// distribute the loop loopID into one loop per group of statements
+// the statements are grouped by strongly connected components of the
+// dependence graph (the loop must keep those together), the components are
+// placed in dependence order and neighbours of the same kind are merged:
+// components with a dependence carried by the loop (sequential) on one
+// side, the ones that can run vectorized or in parallel on the other
+int distribute(osl_scop_p scop, std::vector<int> loopID) {
+    if (loopID.empty() || !check_is_loop(scop, loopID)) return -1;
+    int depth = loopID.size();
+
+    vector<osl_statement_p> body;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id = get_statementID(statement->scattering);
+        if (in_loop(loopID, id) &&
+            depth * 2 - 1 < statement->scattering->nb_output_dims)
+            body.push_back(statement);
+    }
+    int n = body.size();
+    auto index = [&](osl_statement_p s) {
+        return (int)(find(body.begin(), body.end(), s) - body.begin());
+    };
+
+    // the dependences that still matter inside the loop
+    vector<vector<bool>> edge(n, vector<bool>(n, false));
+    vector<vector<bool>> carried(n, vector<bool>(n, false));
+    for (auto& dep : compute_dependences(scop)) {
+        int u = index(dep.source), v = index(dep.sink);
+        if (u == n || v == n || satisfied_before(dep, depth)) continue;
+        edge[u][v] = true;
+        if (carried_at(dep, depth)) carried[u][v] = true;
+    }
+
+    // strongly connected components (transitive closure, the loops are
+    // small), numbered in the order of their first statement
+    vector<vector<bool>> reach = edge;
+    for (int k = 0; k < n; ++k)
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                if (reach[i][k] && reach[k][j]) reach[i][j] = true;
+    vector<int> component(n, -1);
+    int nb_components = 0;
+    for (int i = 0; i < n; ++i) {
+        if (component[i] >= 0) continue;
+        for (int j = i; j < n; ++j)
+            if (j == i || (reach[i][j] && reach[j][i]))
+                component[j] = nb_components;
+        ++nb_components;
+    }
+
+    // topological order of the components, the earliest statement first
+    vector<int> order;
+    vector<bool> placed(nb_components, false);
+    while ((int)order.size() < nb_components) {
+        for (int c = 0; c < nb_components; ++c) {
+            if (placed[c]) continue;
+            bool ready = true;
+            for (int i = 0; i < n; ++i)
+                for (int j = 0; j < n; ++j)
+                    if (edge[i][j] && component[j] == c &&
+                        component[i] != c && !placed[component[i]])
+                        ready = false;
+            if (!ready) continue;
+            placed[c] = true;
+            order.push_back(c);
+            break;
+        }
+    }
+
+    // merge neighbours of the same kind, a parallel group only takes a
+    // component it has no carried dependence with
+    vector<int> group(nb_components);
+    vector<bool> sequential(nb_components, false);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            if (carried[i][j] && component[i] == component[j])
+                sequential[component[i]] = true;
+    int nb_groups = 0;
+    for (size_t k = 0; k < order.size(); ++k) {
+        int c = order[k];
+        bool merge = k > 0 && sequential[c] == sequential[order[k - 1]];
+        for (int i = 0; i < n && merge && !sequential[c]; ++i)
+            for (int j = 0; j < n; ++j)
+                if (carried[i][j] && group[component[i]] == nb_groups - 1 &&
+                    component[j] == c)
+                    merge = false;
+        if (!merge) ++nb_groups;
+        group[c] = nb_groups - 1;
+    }
+    if (nb_groups <= 1) return 0;
+
+    // the loops after loopID make room for the new ones
+    int level = depth - 1;
+    int base = loopID.back();
+    vector<int> parent(loopID.begin(), loopID.end() - 1);
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id = get_statementID(statement->scattering);
+        if (in_loop(parent, id) && (int)id.size() > level &&
+            id[level] > base)
+            statement_id_add(statement, level, nb_groups - 1);
+    }
+    for (int i = 0; i < n; ++i)
+        statement_id_modify(body[i], level, base + group[component[i]]);
+    return 0;
+}
+
+// give the statements of the loop loopID a copy in a new loop right after
+// it, return the (original, copy) pairs
+static vector<pair<osl_statement_p, osl_statement_p>> split_loop_copies(
+    osl_scop_p scop, vector<int> loopID) {
+    vector<pair<osl_statement_p, osl_statement_p>> copies;
+    int level = loopID.size() - 1;
+    int base = loopID.back();
+    vector<int> parent(loopID.begin(), loopID.end() - 1);
+    vector<osl_statement_p> body;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id = get_statementID(statement->scattering);
+        if (in_loop(loopID, id))
+            body.push_back(statement);
+        else if (in_loop(parent, id) && (int)id.size() > level &&
+                 id[level] > base)
+            statement_id_add(statement, level, 1);
+    }
+    auto before = statement_list(scop);
+    map<osl_statement_p, osl_statement_p> origin;
+    for (auto statement : body) {
+        osl_statement_p copy = osl_statement_nclone(statement, 1);
+        statement_id_modify(copy, level, base + 1);
+        copy->next = statement->next;
+        statement->next = copy;
+        copies.push_back({statement, copy});
+        origin[copy] = statement;
+    }
+    renumber_copies(scop, before, origin);
+    return copies;
+}
+
+// the rows to add to the domain or the scattering of a statement, one per
+// part: the parts may not have the same columns (local dimensions)
+struct PartRows {
+    bool domain;
+    vector<vector<long long>> rows;
+};
+
+// whether every entry of the rows fits the int of osl_int_set_si
+static bool rows_fit(const PartRows& rows) {
+    for (auto& row : rows.rows)
+        for (auto v : row)
+            if (v < INT_MIN || v > INT_MAX) return false;
+    return true;
+}
+
+// append the row "constraint >= 0" to one part of a relation
+static void add_inequality_part(osl_relation_p part,
+                                const vector<long long>& constraint) {
+    int row = part->nb_rows;
+    osl_relation_insert_blank_row(part, row);
+    osl_int_set_si(part->precision, &part->m[row][0], 1);
+    for (int c = 1; c < part->nb_columns; ++c)
+        osl_int_set_si(part->precision, &part->m[row][c], (int)constraint[c]);
+}
+
+// append every row to its part of the statement
+static void add_inequalities(osl_statement_p statement,
+                             const PartRows& rows) {
+    size_t p = 0;
+    auto relation = rows.domain ? statement->domain : statement->scattering;
+    for (auto part = relation; part != NULL; part = part->next)
+        add_inequality_part(part, rows.rows[p++]);
+}
+
+// the row coeff * c + sum params[k] * N_k + constant >= 0 on the loop
+// counter c at depth, on the domain when c is a plain iterator and on the
+// scattering otherwise
+static PartRows loop_constraint(osl_statement_p statement, int depth,
+                                int coeff, const vector<long long>& params,
+                                long long constant) {
+    int iter, sign;
+    long long offset;
+    PartRows ret;
+    ret.domain =
+        loop_iterator(statement->scattering, depth, iter, sign, offset);
+    auto relation = ret.domain ? statement->domain : statement->scattering;
+    for (auto part = relation; part != NULL; part = part->next) {
+        vector<long long> row(part->nb_columns, 0);
+        int param_pos = part->nb_columns - 1 - part->nb_parameters;
+        for (size_t k = 0; k < params.size() && (int)k < part->nb_parameters;
+             ++k)
+            row[param_pos + k] = params[k];
+        row.back() = constant;
+        if (ret.domain) {
+            // c = sign * (i - offset)
+            row[1 + iter] = coeff * sign;
+            row.back() -= coeff * sign * offset;
+        } else {
+            row[1 + depth * 2 - 1] = coeff;
+        }
+        ret.rows.push_back(row);
+    }
+    return ret;
+}
+
+// split the iterations of the loop loopID at an affine point of the
+// parameters: c < point stays in the loop, c >= point moves to a new loop
+// right after it; point holds the parameter coefficients then a constant,
+// or the constant alone
+int index_set_split(osl_scop_p scop, std::vector<int> loopID,
+                    std::vector<int> point) {
+    if (loopID.empty() || !check_is_loop(scop, loopID) || point.empty())
+        return -1;
+    int depth = loopID.size();
+    vector<long long> params(point.begin(), point.end() - 1);
+    long long constant = point.back();
+    vector<long long> negated;
+    for (auto p : params) negated.push_back(-p);
+
+    // build the rows of every statement before copying any
+    vector<pair<PartRows, PartRows>> constraints;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto scattering = statement->scattering;
+        if (!in_loop(loopID, get_statementID(scattering))) continue;
+        if (point.size() != 1 &&
+            (int)point.size() != scattering->nb_parameters + 1) {
+            cerr << "index_set_split: wrong number of coefficients" << endl;
+            return -1;
+        }
+        // point - 1 - c >= 0, then c - point >= 0
+        auto before =
+            loop_constraint(statement, depth, -1, params, constant - 1);
+        auto after = loop_constraint(statement, depth, 1, negated, -constant);
+        if (!rows_fit(before) || !rows_fit(after)) {
+            cerr << "index_set_split: coefficient too large" << endl;
+            return -1;
+        }
+        constraints.push_back({before, after});
+    }
+
+    size_t k = 0;
+    for (auto& pair : split_loop_copies(scop, loopID)) {
+        add_inequalities(pair.first, constraints[k].first);
+        add_inequalities(pair.second, constraints[k].second);
+        ++k;
+    }
+    return 0;
+}
+
+// peel the first n iterations of the loop loopID (the last -n ones if n is
+// negative) into a loop of their own, so the main loop has no boundary case
+// every statement of the loop needs one bound on that side, in its domain
+int peel(osl_scop_p scop, std::vector<int> loopID, int n) {
+    if (loopID.empty() || !check_is_loop(scop, loopID)) return -1;
+    if (n == 0) return 0;
+    int depth = loopID.size();
+    long long count = abs((long long)n);
+
+    // build the rows of every domain part before changing anything
+    // bound >= 0 is i >= first (or i <= first): the peeled copy keeps
+    // count - 1 - bound >= 0, the main one bound - count >= 0
+    vector<pair<PartRows, PartRows>> constraints;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        if (!in_loop(loopID, get_statementID(statement->scattering)))
+            continue;
+        int iter, sign;
+        long long offset;
+        if (!loop_iterator(statement->scattering, depth, iter, sign,
+                           offset)) {
+            cerr << "peel: the loop is not a plain iterator" << endl;
+            return -1;
+        }
+        // the first iterations of c are the lowest i if sign > 0
+        int side = (n > 0) == (sign > 0) ? 1 : -1;
+        PartRows peeled{true, {}}, main{true, {}};
+        for (auto part = statement->domain; part != NULL; part = part->next) {
+            vector<long long> bound;
+            for (int row = 0; row < part->nb_rows; ++row) {
+                long long c = entry(part, row, 1 + iter);
+                // the bounds of the other side do not matter
+                if (c == 0 || (entry(part, row, 0) != 0 && c * side < 0))
+                    continue;
+                if (entry(part, row, 0) == 0 || c != side || !bound.empty()) {
+                    cerr << "peel: no single unit bound on that side" << endl;
+                    return -1;
+                }
+                for (int col = 0; col < part->nb_columns; ++col)
+                    bound.push_back(entry(part, row, col));
+            }
+            if (bound.empty()) {
+                cerr << "peel: the loop is unbounded on that side" << endl;
+                return -1;
+            }
+            vector<long long> row = bound;
+            for (auto& v : row) v = -v;
+            row.back() += count - 1;
+            peeled.rows.push_back(row);
+            bound.back() -= count;
+            main.rows.push_back(bound);
+        }
+        if (!rows_fit(peeled) || !rows_fit(main)) {
+            cerr << "peel: coefficient too large" << endl;
+            return -1;
+        }
+        constraints.push_back({peeled, main});
+    }
+
+    size_t k = 0;
+    for (auto& pair : split_loop_copies(scop, loopID)) {
+        auto& rows = constraints[k++];
+        add_inequalities(n > 0 ? pair.first : pair.second, rows.first);
+        add_inequalities(n > 0 ? pair.second : pair.first, rows.second);
+    }
+    return 0;
+}
+
+// record the loop at depth of the statements of loopID as parallel in the
+// osl_loop extension, the code generator prints it as an OpenMP loop
+static void mark_parallel(osl_scop_p scop, const vector<int>& loopID,
+                          unsigned int depth) {
+    osl_scatnames_p scat = (osl_scatnames_p)osl_generic_lookup(
+        scop->extension, OSL_URI_SCATNAMES);
+    auto scat_name = [&](int dim) {
+        if (scat != NULL && scat->names != NULL &&
+            dim < osl_strings_size(scat->names))
+            return string(scat->names->string[dim]);
+        return "c" + to_string(dim + 1);
+    };
+    string iter = scat_name(depth * 2 - 1);
+
+    // the inner loop counters and the statement iterators are written in
+    // every iteration, each thread needs its own
+    vector<int> ids;
+    set<string> seen = {iter};
+    string private_vars;
+    auto add_private = [&](const string& name) {
+        if (!seen.insert(name).second) return;
+        if (!private_vars.empty()) private_vars += ",";
+        private_vars += name;
+    };
+    int number = 1;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next, ++number) {
+        if (!in_loop(loopID, get_statementID(statement->scattering)))
+            continue;
+        ids.push_back(number);
+        int out = statement->scattering->nb_output_dims;
+        for (int dim = depth * 2 + 1; dim < out; dim += 2)
+            add_private(scat_name(dim));
+        osl_body_p body =
+            (osl_body_p)osl_generic_lookup(statement->extension, OSL_URI_BODY);
+        if (body == NULL || body->iterators == NULL) continue;
+        for (char** it = body->iterators->string; *it != NULL; ++it)
+            add_private(*it);
+    }
+
+    osl_loop_p loop = osl_loop_malloc();
+    loop->iter = strdup(iter.c_str());
+    loop->nb_stmts = ids.size();
+    loop->stmt_ids = (int*)malloc(sizeof(int) * ids.size());
+    copy(ids.begin(), ids.end(), loop->stmt_ids);
+    if (!private_vars.empty())
+        loop->private_vars = strdup(private_vars.c_str());
+    loop->directive = OSL_LOOP_DIRECTIVE_PARALLEL;
+
+    osl_loop_p loops =
+        (osl_loop_p)osl_generic_lookup(scop->extension, OSL_URI_LOOP);
+    if (loops == NULL)
+        osl_generic_add(&scop->extension,
+                        osl_generic_shell(loop, osl_loop_interface()));
+    else
+        osl_loop_add(&loops, loop);
+}
+
+// skew the band of loops depth .. depth + levels - 1 until every
+// dependence has non-negative distances on it, then make the first loop
+// of the band the sum of them all: it runs the wavefronts in order and
+// the loop below it carries no dependence
+int wavefront(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
+              unsigned int levels) {
+    if (depth < 1 || depth < loopID.size()) return -1;
+
+    // the band must be common to all the statements of the nest
+    vector<osl_statement_p> nest;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next)
+        if (in_loop(loopID, get_statementID(statement->scattering)))
+            nest.push_back(statement);
+    if (nest.empty()) return -1;
+    int common = INT_MAX;
+    for (auto s : nest)
+        for (auto t : nest) common = min(common, common_loops(s, t));
+    int last = levels == 0 ? common : (int)(depth + levels) - 1;
+    if (last > common || last <= (int)depth) {
+        cerr << "wavefront: the band needs two loops of the whole nest"
+             << endl;
+        return -1;
+    }
+
+    // the dependences of the nest still to be satisfied by the band
+    int first = depth - 1;
+    vector<long long> factor(last, 0);
+    for (auto& dep : compute_dependences(scop)) {
+        if (!in_loop(loopID, get_statementID(dep.source->scattering)) ||
+            !in_loop(loopID, get_statementID(dep.sink->scattering)) ||
+            satisfied_before(dep, depth))
+            continue;
+        for (int e = first; e < last; ++e)
+            if (dep.distance[e] == DIST_ANY) {
+                cerr << "wavefront: unknown dependence distance" << endl;
+                return -1;
+            }
+        // d_e + f * d_first >= 0 on every loop of the band
+        long long d_first = dep.distance[first];
+        for (int e = first + 1; e < last; ++e) {
+            long long d = dep.distance[e];
+            if (d >= 0) continue;
+            if (d_first == 0) {
+                cerr << "wavefront: the band is not permutable" << endl;
+                return -1;
+            }
+            factor[e] = max(factor[e], ceil_div(-d, d_first));
+        }
+    }
+
+    // c_e += f_e * c_first, then c_first += c_e
+    UnimodularChain chain;
+    for (int e = first + 1; e < last; ++e)
+        if (factor[e] != 0)
+            chain.add_skew(loopID, e + 1, depth, -(int)factor[e]);
+    for (int e = first + 1; e < last; ++e)
+        chain.add_skew(loopID, depth, e + 1, -1);
+    chain.apply(scop);
+
+    mark_parallel(scop, loopID, depth + 1);
+    return 0;
+}
+
+// the arrays the statements of loopID access
+static set<int> loop_arrays(osl_scop_p scop, const vector<int>& loopID) {
+    set<int> arrays;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        if (!in_loop(loopID, get_statementID(statement->scattering)))
+            continue;
+        for (auto l = statement->access; l != NULL; l = l->next) {
+            AccessFunction f;
+            if (access_function(l->elt, f)) arrays.insert(f.array);
+        }
+    }
+    return arrays;
+}
+
+// whether fusing next_loop_id into loopID keeps every dependence between
+// the two loops from the first one to the second one
+static bool fusion_legal(osl_scop_p scop, const vector<int>& loopID,
+                         const vector<int>& next_loop_id) {
+    OwnedScop owned = clone_scop(scop);
+    osl_scop_p trial = owned.get();
+
+    // the clone keeps the order of the statements
+    map<osl_statement_p, int> side;
+    for (auto s = scop->statement, t = trial->statement; s != NULL;
+         s = s->next, t = t->next) {
+        auto id = get_statementID(s->scattering);
+        side[t] = in_loop(loopID, id) ? 1 : in_loop(next_loop_id, id) ? 2 : 0;
+    }
+    fuse_loops(trial, loopID, next_loop_id);
+
+    bool legal = true;
+    for (auto& dep : compute_dependences(trial))
+        if (side[dep.source] == 2 && side[dep.sink] == 1 &&
+            !satisfied_before(dep, loopID.size()))
+            legal = false;
+    return legal;
+}
+
+// fuse the child loops of loopID, then the loops inside each of them
+static void fuse_children(osl_scop_p scop, const vector<int>& loopID) {
+    while (true) {
+        // the children in order, with whether each one is a loop
+        map<int, bool> children;
+        for (auto statement = scop->statement; statement != NULL;
+             statement = statement->next) {
+            auto id = get_statementID(statement->scattering);
+            if (!in_loop(loopID, id) || id.size() <= loopID.size()) continue;
+            children[id[loopID.size()]] |= id.size() > loopID.size() + 1;
+        }
+
+        // the neighbour loops (no statement in between) by shared arrays
+        vector<pair<int, pair<int, int>>> candidates;
+        for (auto it = children.begin(); it != children.end(); ++it) {
+            auto next = it;
+            if (++next == children.end()) break;
+            if (!it->second || !next->second) continue;
+            vector<int> a = loopID, b = loopID;
+            a.push_back(it->first);
+            b.push_back(next->first);
+            set<int> arrays_a = loop_arrays(scop, a);
+            int score = 0;
+            for (int array : loop_arrays(scop, b))
+                score += arrays_a.count(array);
+            if (score > 0)
+                candidates.push_back({score, {it->first, next->first}});
+        }
+        stable_sort(candidates.begin(), candidates.end(),
+                    [](const pair<int, pair<int, int>>& x,
+                       const pair<int, pair<int, int>>& y) {
+                        return x.first > y.first;
+                    });
+
+        // the best legal pair, one at a time since a fusion changes the
+        // neighbours of the fused loop
+        bool fused = false;
+        for (auto& candidate : candidates) {
+            vector<int> a = loopID, b = loopID;
+            a.push_back(candidate.second.first);
+            b.push_back(candidate.second.second);
+            if (!fusion_legal(scop, a, b)) continue;
+            fuse_loops(scop, a, b);
+            fused = true;
+            break;
+        }
+        if (!fused) {
+            for (auto& child : children) {
+                if (!child.second) continue;
+                vector<int> inner = loopID;
+                inner.push_back(child.first);
+                fuse_children(scop, inner);
+            }
+            return;
+        }
+    }
+}
+
+// greedy fusion of the loops under loopID (the whole scop if empty):
+// neighbour loops sharing the most arrays are fused first, as long as no
+// dependence between them is reversed, then the pass goes down the tree
+int auto_fuse(osl_scop_p scop, std::vector<int> loopID) {
+    if (!loopID.empty() && !check_is_loop(scop, loopID)) return -1;
+    fuse_children(scop, loopID);
+    return 0;
+}
+
+// whether the dependence stays lexicographically positive when the loops
+// are visited in order (0-based loop indices)
+static bool order_legal(const Dependence& dep, const vector<int>& order) {
+    // the first non-zero component of the original order is positive,
+    // even when unknown
+    int lead = 0;
+    while (lead < (int)dep.distance.size() && dep.distance[lead] == 0) ++lead;
+    for (int e : order) {
+        long long d = dep.distance[e];
+        if (e == lead && d == DIST_ANY) continue;
+        if (d == DIST_ANY || d < 0) return false;
+        if (d > 0) return true;
+    }
+    return true;
+}
+
+// stride-1 score of the loop at depth: the references whose last
+// subscript moves by one with it and the other ones not at all count
+// for the number of references to their array, the ones it walks across
+// rows count against it
+static long long stride_score(const vector<osl_statement_p>& nest,
+                              unsigned int depth) {
+    map<int, int> references;
+    for (auto s : nest)
+        for (auto l = s->access; l != NULL; l = l->next) {
+            AccessFunction f;
+            if (access_function(l->elt, f)) ++references[f.array];
+        }
+
+    long long score = 0;
+    for (auto s : nest) {
+        int iter, sign;
+        long long offset;
+        if (!loop_iterator(s->scattering, depth, iter, sign, offset))
+            continue;
+        for (auto l = s->access; l != NULL; l = l->next) {
+            AccessFunction f;
+            if (!access_function(l->elt, f) || f.dims.empty()) continue;
+            bool outer = false;
+            for (size_t r = 0; r + 1 < f.dims.size(); ++r)
+                outer |= f.dims[r][iter] != 0;
+            long long last = llabs(f.dims.back()[iter]);
+            if (outer)
+                score -= references[f.array];
+            else if (last == 1)
+                score += references[f.array];
+        }
+    }
+    return score;
+}
+
+// move the loop with the best stride-1 score innermost in the band of
+// loops the statements of loopID share, if the dependences allow it
+static int permute_nest(osl_scop_p scop, const vector<int>& loopID) {
+    vector<osl_statement_p> nest;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next)
+        if (in_loop(loopID, get_statementID(statement->scattering)))
+            nest.push_back(statement);
+    if (nest.empty()) return -1;
+    int first = loopID.size();
+    int last = INT_MAX;
+    for (auto s : nest)
+        for (auto t : nest) last = min(last, common_loops(s, t));
+    if (last <= first) return 0;
+
+    vector<Dependence> deps;
+    for (auto& dep : compute_dependences(scop))
+        if (in_loop(loopID, get_statementID(dep.source->scattering)) &&
+            in_loop(loopID, get_statementID(dep.sink->scattering)) &&
+            !satisfied_before(dep, first))
+            deps.push_back(dep);
+
+    // candidates by decreasing score, better than the innermost loop
+    vector<pair<long long, int>> candidates;
+    long long innermost = stride_score(nest, last);
+    for (int depth = first; depth < last; ++depth) {
+        long long score = stride_score(nest, depth);
+        if (score > innermost) candidates.push_back({-score, depth});
+    }
+    sort(candidates.begin(), candidates.end());
+
+    for (auto& candidate : candidates) {
+        int depth = candidate.second;
+        vector<int> order;
+        for (int e = first; e <= last; ++e)
+            if (e != depth) order.push_back(e - 1);
+        order.push_back(depth - 1);
+        bool legal = true;
+        for (auto& dep : deps) legal &= order_legal(dep, order);
+        if (!legal) continue;
+
+        // rotate it down one loop at a time, as interchange() does
+        int pretty =
+            osl_generic_lookup(scop->extension, OSL_URI_SCATNAMES) != NULL;
+        for (int e = depth; e < last; ++e)
+            interchange(scop, loopID, e, e + 1, pretty);
+        return 0;
+    }
+    return 0;
+}
+
+// permute the loop nest loopID (every outermost nest if empty) to make
+// the loop with the most stride-1 references innermost
+int permute(osl_scop_p scop, std::vector<int> loopID) {
+    if (!loopID.empty()) {
+        if (!check_is_loop(scop, loopID)) return -1;
+        return permute_nest(scop, loopID);
+    }
+    set<int> nests;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        auto id = get_statementID(statement->scattering);
+        if (id.size() > 1) nests.insert(id[0]);
+    }
+    for (int nest : nests)
+        if (permute_nest(scop, {nest}) != 0) return -1;
+    return 0;
+}
+
+// renumber the children of every node of the beta tree 0, 1, 2, ... in
+// order, closing the gaps split(), reorder() and fuse() leave
+int normalize_betas(osl_scop_p scop) {
+    vector<osl_statement_p> statements;
+    vector<vector<int>> ids;
+    size_t length = 0;
+    for (auto statement = scop->statement; statement != NULL;
+         statement = statement->next) {
+        statements.push_back(statement);
+        ids.push_back(get_statementID(statement->scattering));
+        length = max(length, ids.back().size());
+    }
+
+    vector<vector<int>> dense = ids;
+    for (size_t l = 0; l < length; ++l) {
+        map<vector<int>, set<int>> children;
+        for (auto& id : ids)
+            if (id.size() > l)
+                children[vector<int>(id.begin(), id.begin() + l)].insert(id[l]);
+        for (size_t k = 0; k < ids.size(); ++k) {
+            if (ids[k].size() <= l) continue;
+            auto& betas =
+                children[vector<int>(ids[k].begin(), ids[k].begin() + l)];
+            dense[k][l] = distance(betas.begin(), betas.find(ids[k][l]));
+        }
+    }
+    for (size_t k = 0; k < ids.size(); ++k)
+        for (size_t l = 0; l < ids[k].size(); ++l)
+            if (dense[k][l] != ids[k][l])
+                statement_id_modify(statements[k], l, dense[k][l]);
+    return 0;
+}
@@ -4,306 +4,294 @@
 #include <cloog/cloog.h>
 #include <osl/osl.h>
 
+#include <cctype>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <vector>
 
-#include "parser.h"
-#include "utility.h"
+#include "affine.h"
+#include "gpt.h"
+#include "raii.h"
 
 using namespace std;
 
-int split(osl_scop_p scop, std::vector<int> statementID, unsigned int depth);
-
-int reorder(osl_scop_p scop, std::vector<int> loopID,
-            std::vector<int> neworder);
-
-int interchange(osl_scop_p scop, std::vector<int> loopID, unsigned int depth_1,
-                unsigned int depth_2, int pretty);
-
-int fuse(osl_scop_p scop, std::vector<int> loopID);
-
-int skew(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
-         unsigned int depth_other, int coeff);
-
-int tile(osl_scop_p scop, std::vector<int> statementID, unsigned int depth,
-         unsigned int depth_outer, unsigned int size);
-
-// BONUS
-/** unroll function
- * Unroll a loop
- * scop: the SCoP to be transformed
- * statementID: the statement scattering ID on AST
- * factor: unroll factor
- * return status
- */
-// int unroll(osl_scop_p scop, std::vector<int> statementID, unsigned int
-// factor);
-
-/* Use the Clan library to convert a SCoP from C to OpenScop */
-osl_scop_p read_scop_from_c(FILE* input, char* input_name) {
-    clan_options_p clanoptions;
-    osl_scop_p scop;
-    clanoptions = clan_options_malloc();
-    clanoptions->precision = OSL_PRECISION_MP;
-    CLAN_strdup(clanoptions->name, input_name);
-    scop = clan_scop_extract(input, clanoptions);
-    clan_options_free(clanoptions);
-    return scop;
+// read a C file with Clan (through the region cache in cache_dir if any),
+// or an OpenScop file (text or binary)
+osl_scop_p read_input(FILE* input, char* input_name, const char* cache_dir) {
+    string name = input_name;
+    if (is_scop_binary(input)) return read_scop_binary(input);
+    if (name.length() > 5 && name.substr(name.length() - 5) == ".scop")
+        return osl_scop_read(input);
+    if (cache_dir == NULL) return read_scop_from_c(input, input_name);
+    string source;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), input)) > 0)
+        source.append(buffer, n);
+    return read_scop_from_string_cached(source, input_name, cache_dir);
 }
 
-/* Use the CLooG library to output a SCoP from OpenScop to C */
-void print_scop_to_c(FILE* output, osl_scop_p scop) {
-    CloogState* state;
-    CloogOptions* options;
-    CloogInput* input;
-    struct clast_stmt* clast;
-    state = cloog_state_malloc();
-    options = cloog_options_malloc(state);
-    options->openscop = 1;
-    cloog_options_copy_from_osl_scop(scop, options);
-    input = cloog_input_from_osl_scop(options->state, scop);
-    clast = cloog_clast_create_from_input(input, options);
-    clast_pprint(output, clast, 0, options);
-    cloog_clast_free(clast);
-    options->scop = NULL;  // don’t free the scop
-    cloog_options_free(options);
-    cloog_state_free(state);  // the input is freed inside
+// dump the scop to path.scop, or to path.bscop in the binary format
+void dump_scop(string path, osl_scop_p scop, bool binary) {
+    OwnedFile file(fopen((path + (binary ? ".bscop" : ".scop")).c_str(), "w"));
+    if (!file) return;
+    if (binary)
+        write_scop_binary(file.get(), scop);
+    else
+        osl_scop_print(file.get(), scop);
 }
 
-void transformation(osl_scop_p scop) {
-    printf("===============args=================\n");
-    vector<BaseArg*> args;
-    int func = parser(scop, args);
-    switch (func) {
-        case SPLIT: {
-            auto arg0 = (VectorArg*)args[0];
-            auto arg1 = (SingleIntArg*)args[1];
-            arg0->display();
-            arg1->display();
-            split(scop, arg0->arg, arg1->arg);
-            break;
+// rewrite every file in place of its scop regions into name.gpt.c
+int rewrite_files(vector<char*> names, int jobs, const char* cache_dir) {
+    int failed = 0;
+    for (auto name : names) {
+        ifstream in(name);
+        if (!in) {
+            fprintf(stderr, "cannot open %s\n", name);
+            ++failed;
+            continue;
         }
-        case REORDER: {
-            auto arg0 = (VectorArg*)args[0];
-            auto arg1 = (VectorArg*)args[1];
-            arg0->display();
-            arg1->display();
-            reorder(scop, arg0->arg, arg1->arg);
-            break;
+        stringstream source;
+        source << in.rdbuf();
+
+        string result;
+        if (rewrite_source(source.str(), name, result, jobs,
+                           cache_dir == NULL ? "" : cache_dir) != 0) {
+            fprintf(stderr, "cannot rewrite %s\n", name);
+            ++failed;
+            continue;
         }
-        case INTERCHANGE: {
-            auto arg0 = (VectorArg*)args[0];
-            auto arg1 = (SingleIntArg*)args[1];
-            auto arg2 = (SingleIntArg*)args[2];
-            auto arg3 = (SingleIntArg*)args[3];
-            arg0->display();
-            arg1->display();
-            arg2->display();
-            arg3->display();
-            interchange(scop, arg0->arg, arg1->arg, arg2->arg, arg3->arg);
-            break;
-        }
-        case FUSE: {
-            auto arg0 = (VectorArg*)args[0];
-            arg0->display();
-            fuse(scop, arg0->arg);
-            break;
-        }
-        case SKEW: {
-            auto arg0 = (VectorArg*)args[0];
-            auto arg1 = (SingleIntArg*)args[1];
-            auto arg2 = (SingleIntArg*)args[2];
-            auto arg3 = (SingleIntArg*)args[3];
-            arg0->display();
-            arg1->display();
-            arg2->display();
-            arg3->display();
-            skew(scop, arg0->arg, arg1->arg, arg2->arg, arg3->arg);
-            break;
-        }
-        case TILE: {
-            auto arg0 = (VectorArg*)args[0];
-            auto arg1 = (SingleIntArg*)args[1];
-            auto arg2 = (SingleIntArg*)args[2];
-            auto arg3 = (SingleIntArg*)args[3];
-            arg0->display();
-            arg1->display();
-            arg2->display();
-            arg3->display();
-            tile(scop, arg0->arg, arg1->arg, arg2->arg, arg3->arg);
-            break;
-        }
-        default:
-            cerr << "Unknown transformation: " << func << endl;
-            break;
-    }
-    printf("===========end of args==============\n");
-    for (auto ptr : args) {
-        if (ptr->type == 0)
-            delete (SingleIntArg*)ptr;
-        else
-            delete (VectorArg*)ptr;
+
+        string target = name;
+        size_t dot = target.rfind('.');
+        if (dot == string::npos || target.find('/', dot) != string::npos)
+            dot = target.length();
+        target.insert(dot, ".gpt");
+        ofstream out(target);
+        out << result;
     }
+    return failed == 0 ? 0 : 1;
 }
 
-int main(int argc, char* argv[]) {
-    osl_scop_p scop;
-    FILE* input;
-    if ((argc < 2) || (argc > 2)) {
-        fprintf(stderr, "usage: %s file.c\n", argv[0]);
-        exit(0);
-    }
-    if (argc == 1)
-        input = stdin;
-    else
-        input = fopen(argv[1], "r");
-    if (input == NULL) {
-        fprintf(stderr, "cannot open input file\n");
-        exit(0);
+// rank the candidate scripts of every scop with the static cache model
+// without a candidates file: the original schedule and its clay script
+int analyze_scops(osl_scop_p scop, const char* candidates,
+                  const CacheConfig& cache, const map<string, long>& values) {
+    vector<string> scripts;
+    if (candidates != NULL) {
+        ifstream in(candidates);
+        if (!in) {
+            fprintf(stderr, "cannot open %s\n", candidates);
+            return 1;
+        }
+        string line;
+        while (getline(in, line))
+            if (line.find_first_not_of(" \t") != string::npos &&
+                line[0] != '#')
+                scripts.push_back(line);
     }
-    scop = read_scop_from_c(input, argv[1]);
-
-    // original scop
-    FILE* original = fopen("./testspace/original.scop", "w");
-    osl_scop_print(original, scop);
-
-    // do the transformations
-    transformation(scop);
-
-    // transformed scop
-    FILE* transformed = fopen("./testspace/transformed.scop", "w");
-    osl_scop_print(transformed, scop);
-
-    // transformed scop to c
-    FILE* output = fopen("./testspace/output.c", "w");
-    print_scop_to_c(output, scop);
-
-    osl_scop_free(scop);
-    fclose(input);
-    return 0;
-}
 
-int split(osl_scop_p scop, std::vector<int> statementID, unsigned int depth) {
-    statement_shift(scop->statement, statementID, depth);
-    return 0;
-}
+    int nb = 0;
+    for (auto s = scop; s != NULL; s = s->next) {
+        vector<string> tried = scripts;
+        if (candidates == NULL) {
+            osl_clay_p clay =
+                (osl_clay_p)osl_generic_lookup(s->extension, OSL_URI_CLAY);
+            tried = {""};
+            if (clay != NULL && clay->script != NULL)
+                tried.push_back(clay->script);
+        }
 
-// the loopID represents a unique loop (or a node in the AST)
-// if the loopID is empty, then the whole scop is reordered
-int reorder(osl_scop_p scop, std::vector<int> loopID,
-            std::vector<int> neworder) {
-    for (auto statement = scop->statement; statement != NULL;
-         statement = statement->next) {
-        auto id1 = get_statementID(statement->scattering);
-        // check if the statement is in the loop
-        if (in_loop(loopID, id1)) {
-            // the position to be modified
-            int index = loopID.size();
-            // old order
-            int old_order = id1[index];
-            // new order
-            int new_order = neworder[old_order];
-            statement_id_modify(statement, index, new_order);
+        vector<long> params = parameter_values(s, values);
+        auto start = chrono::steady_clock::now();
+        vector<CacheEstimate> estimates;
+        auto order = rank_schedules(s, tried, params, cache, estimates);
+        double ms = chrono::duration<double, milli>(
+                        chrono::steady_clock::now() - start)
+                        .count();
+
+        printf("scop %d: %zu schedules ranked in %.2f ms\n", ++nb,
+               tried.size(), ms);
+        for (size_t r = 0; r < order.size(); ++r) {
+            auto& e = estimates[order[r]];
+            string script = tried[order[r]];
+            if (script.empty()) script = "(original)";
+            if (e.misses < 0)
+                printf("  -   invalid %s\n", script.c_str());
+            else
+                printf("  %-3zu misses %-10.4g accesses %-10.4g "
+                       "reuse %-8.4g %s\n",
+                       r + 1, e.misses, e.accesses, e.reuse, script.c_str());
         }
     }
     return 0;
 }
 
-// just swap the depth_1 loop column and depth_2 loop column
-int interchange(osl_scop_p scop, std::vector<int> loopID, unsigned int depth_1,
-                unsigned int depth_2, int pretty) {
-    if (depth_1 == depth_2) return 0;
-    // get the index in scattering matrix
-    int idx1 = depth_1 * 2 - 1;
-    int idx2 = depth_2 * 2 - 1;
-    for (auto statement = scop->statement; statement != NULL;
-         statement = statement->next) {
-        auto id1 = get_statementID(statement->scattering);
-        if (in_loop(loopID, id1)) {
-            // display_statement(statement);
-            // swap the column idx1 and idx2
-            for (int row = 0; row < statement->scattering->nb_rows; row++) {
-                osl_int_swap(statement->scattering->precision,
-                             &statement->scattering->m[row][idx1 + 1],
-                             &statement->scattering->m[row][idx2 + 1]);
-            }
-        }
+// compare the transformed scop with a reference OpenScop file
+int check_scop(osl_scop_p scop, const char* reference_name) {
+    OwnedFile file(fopen(reference_name, "r"));
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", reference_name);
+        return 1;
     }
+    OwnedScop reference(read_scop_from_file(file.get()));
+    if (!reference) {
+        fprintf(stderr, "cannot read a scop from %s\n", reference_name);
+        return 1;
+    }
+    string difference;
+    bool equal = scop_equivalent(scop, reference.get(), difference);
+    if (equal)
+        printf("equivalent to %s\n", reference_name);
+    else
+        printf("differs from %s: %s\n", reference_name, difference.c_str());
+    return equal ? 0 : 1;
+}
 
-    if (pretty) {
-        osl_strings_p names = ((osl_scatnames_p)osl_generic_lookup(
-                                   scop->extension, OSL_URI_SCATNAMES))
-                                  ->names;
-        swap(names->string[idx1], names->string[idx2]);
+// time the code of every scop, compiled and loaded in the process
+int execute_scops(osl_scop_p scop, const map<string, long>& values,
+                  int reps) {
+    int nb = 0, failed = 0;
+    for (auto s = scop; s != NULL; s = s->next) {
+        osl_scop_p next = s->next;
+        s->next = NULL;
+        JitKernel kernel;
+        auto start = chrono::steady_clock::now();
+        bool ok = jit_compile(s, parameter_values(s, values), kernel);
+        double build = chrono::duration<double, milli>(
+                           chrono::steady_clock::now() - start)
+                           .count();
+        s->next = next;
+        if (!ok) {
+            printf("scop %d: failed\n", ++nb);
+            ++failed;
+            continue;
+        }
+        auto arrays = jit_arrays(kernel);
+        double seconds = jit_run(kernel, arrays, reps);
+        printf("scop %d: built in %.0f ms, runs in %.6f s\n", ++nb, build,
+               seconds);
+        jit_free(kernel);
     }
+    return failed == 0 ? 0 : 1;
+}
 
-    return 0;
+// NAME=value with a C identifier and an integer, in any position on the
+// command line (a file name is not an identifier followed by a number)
+static bool parameter_assignment(const char* arg, string& name, long& value) {
+    const char* eq = strchr(arg, '=');
+    if (eq == NULL || eq == arg || isdigit((unsigned char)arg[0])) return false;
+    for (const char* c = arg; c < eq; ++c)
+        if (!isalnum((unsigned char)*c) && *c != '_') return false;
+    char* end;
+    value = strtol(eq + 1, &end, 10);
+    if (end == eq + 1 || *end != '\0') return false;
+    name = string(arg, eq - arg);
+    return true;
 }
 
-// fuse means to merge two loops into one
-int fuse(osl_scop_p scop, std::vector<int> loopID) {
-    // check whether the loopID is valid
-    if (!check_is_loop(scop, loopID)) return -1;
+static void report_allocations() { print_allocation_report(stderr); }
 
-    vector<int> next_loop_id = get_next_loop(scop, loopID);
-    // if there is no next loop to fuse
-    if (next_loop_id.empty()) return -1;
+int main(int argc, char* argv[]) {
+    char* input_name = NULL;
+    vector<char*> input_names;
+    bool binary = false, rewrite = false, analyze = false, execute = false;
+    bool memory = false;
+    int jobs = 0, reps = 5;
+    const char* candidates = NULL;
+    const char* reference_name = NULL;
+    const char* cache_dir = NULL;
+    CacheConfig cache;
+    map<string, long> values;
+    string name;
+    long value;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--binary") == 0)
+            binary = true;
+        else if (strcmp(argv[i], "--rewrite") == 0)
+            rewrite = true;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--analyze") == 0)
+            analyze = true;
+        else if (strcmp(argv[i], "--memory") == 0)
+            memory = true;
+        else if (strcmp(argv[i], "--execute") == 0)
+            execute = true;
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            reps = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc)
+            candidates = argv[++i];
+        else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+            reference_name = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%ld,%ld", &cache.size, &cache.line);
+        else if (strcmp(argv[i], "--scop-cache") == 0 && i + 1 < argc)
+            cache_dir = argv[++i];
+        else if (parameter_assignment(argv[i], name, value))
+            values[name] = value;
+        else
+            input_names.push_back(argv[i]);
+    }
+    if (input_names.empty() || (!rewrite && input_names.size() > 1)) {
+        fprintf(stderr,
+                "usage: %s [--binary] [--memory] [-j jobs] "
+                "[--scop-cache dir] file.c|file.scop|file.bscop\n"
+                "       %s --rewrite [-j jobs] [--scop-cache dir] file.c...\n"
+                "       %s --analyze [--cache size,line] "
+                "[--candidates scripts.txt] file.c [N=value...]\n"
+                "       %s --check reference.scop file.c\n"
+                "       %s --execute [-r reps] file.c [N=value...]\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0]);
+        exit(0);
+    }
+    // reported once the owners of main are gone
+    if (memory) atexit(report_allocations);
+    if (rewrite) return rewrite_files(input_names, jobs, cache_dir);
 
-    int fuse_val = loopID.back();
-    auto max_id = find_max_in_loop(scop, loopID);
-    int base_val = max_id[loopID.size()];
+    input_name = input_names[0];
+    OwnedFile input(fopen(input_name, "r"));
+    if (!input) {
+        fprintf(stderr, "cannot open input file\n");
+        return 0;
+    }
+    OwnedScop owned(read_input(input.get(), input_name, cache_dir));
+    osl_scop_p scop = owned.get();
+    if (scop == NULL) {
+        fprintf(stderr, "cannot read a scop from %s\n", input_name);
+        return 1;
+    }
 
-    for (auto statement = scop->statement; statement != NULL;
-         statement = statement->next) {
-        auto precision = statement->scattering->precision;
-        auto statement_id = get_statementID(statement->scattering);
-        if (in_loop(next_loop_id, statement_id)) {
-            int constant_pos = statement->scattering->nb_columns - 1;
-            // change the level
-            statement_id_modify(statement, loopID.size() - 1, fuse_val);
+    if (analyze) return analyze_scops(scop, candidates, cache, values);
 
-            // cat the statement behind the max id
-            statement_id_add(statement, loopID.size(), base_val + 1);
-        }
-    }
+    // original scop
+    dump_scop("./testspace/original", scop, binary);
 
-    return 0;
-}
+    // do the transformations, every scop with its own clay script
+    printf("===============args=================\n");
+    apply_clay_all(scop, jobs, true);
+    printf("===========end of args==============\n");
 
-int skew(osl_scop_p scop, std::vector<int> loopID, unsigned int depth,
-         unsigned int depth_other, int coeff) {
-    int idx1 = depth * 2 - 1;
-    int idx2 = depth_other * 2 - 1;
+    // transformed scop
+    dump_scop("./testspace/transformed", scop, binary);
 
-    for (auto statement = scop->statement; statement != NULL;
-         statement = statement->next) {
-        auto scattering = statement->scattering;
-        auto precision = scattering->precision;
-        auto statement_id = get_statementID(scattering);
+    // time the transformed code instead of writing it
+    if (execute) return execute_scops(scop, values, reps);
 
-        if (in_loop(loopID, statement_id)) {
-            // every row should be transformed !!!
-            for (int row = 0; row < scattering->nb_rows; ++row) {
-                int t = osl_int_get_si(0, scattering->m[row][idx1 + 1]);
-                t = t * coeff;
-                osl_int_add_si(precision, &scattering->m[row][idx2 + 1],
-                               scattering->m[row][idx2 + 1], t);
-            }
-        }
-    }
+    // compare with the reference instead of generating code
+    if (reference_name != NULL) return check_scop(scop, reference_name);
 
+    // transformed scop to c
+    OwnedFile output(fopen("./testspace/output.c", "w"));
+    if (!output) {
+        fprintf(stderr, "cannot open ./testspace/output.c\n");
+        return 1;
+    }
+    print_scops_to_c(output.get(), scop, jobs);
     return 0;
 }
-
-int tile(osl_scop_p scop, std::vector<int> loop_id, unsigned int depth,
-         unsigned int depth_outer, unsigned int size) {
-    stripmine(scop, loop_id, depth, size);
-    // update the lood_id
-    vector<int> new_loop_id = loop_id;
-    new_loop_id.push_back(0);
-    for (int i = depth; i < loop_id.size(); ++i)
-        new_loop_id.push_back(loop_id[i]);
-    interchange(scop, new_loop_id, depth, depth_outer, 1);
-    return 0;
-}
\ No newline at end of file
@@ -5,14 +5,18 @@
 #include <cloog/cloog.h>
 #include <osl/osl.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <map>
 #include <vector>
 
+#include "compact.h"
+
 using namespace std;
 
 // display the statement for debug
-void display_statement(osl_statement_p statement) {
+inline void display_statement(osl_statement_p statement) {
     cerr << statement->extension->interface->sprint(statement->extension->data)
          << endl;
 }
@@ -20,7 +24,7 @@ void display_statement(osl_statement_p statement) {
 // find the k-th element's row
 // row in the relation matrix may not be ordered
 // but column is ordered naturally
-int find_row(osl_relation_p realation, int k) {
+inline int find_row(osl_relation_p realation, int k) {
     for (int i = 0; i < realation->nb_rows; ++i) {
         // start with e/i : so k + 1
         if (!osl_int_zero(realation->precision, realation->m[i][k + 1])) {
@@ -31,7 +35,7 @@ int find_row(osl_relation_p realation, int k) {
 }
 
 // extract the statementID from the scattering
-vector<int> get_statementID(osl_relation_p scattering) {
+inline vector<int> get_statementID(osl_relation_p scattering) {
     vector<int> statementID;
 
     // get the last element of the row : multiplication for constant 1
@@ -49,7 +53,7 @@ vector<int> get_statementID(osl_relation_p scattering) {
 }
 
 // find the different position of two vectors and return the difference
-int id_compare(vector<int> id0, vector<int> id1, int& d_pos) {
+inline int id_compare(vector<int> id0, vector<int> id1, int& d_pos) {
     // do not worry about the lengths not match : must have difference
     int len = min(id0.size(), id1.size());
     for (int i = 0; i < len; ++i) {
@@ -63,8 +67,8 @@ int id_compare(vector<int> id0, vector<int> id1, int& d_pos) {
 }
 
 // shift all the statements after the statementID at depth
-void statement_shift(osl_statement_p statement, vector<int> id0,
-                     unsigned int depth) {
+inline void statement_shift(osl_statement_p statement, vector<int> id0,
+                            unsigned int depth) {
     int col = (depth - 1) * 2;
     for (; statement != NULL; statement = statement->next) {
         auto id = get_statementID(statement->scattering);
@@ -87,7 +91,7 @@ void statement_shift(osl_statement_p statement, vector<int> id0,
 
 // change the k-th id of the statement to x
 // the output scattering index should be 2 * k
-void statement_id_modify(osl_statement_p statement, int k, int x) {
+inline void statement_id_modify(osl_statement_p statement, int k, int x) {
     int row = find_row(statement->scattering, 2 * k);
     int constant_pos = statement->scattering->nb_columns - 1;
     // display_statement(statement);
@@ -99,7 +103,7 @@ void statement_id_modify(osl_statement_p statement, int k, int x) {
 }
 
 // add x to the k-th id of the statement
-void statement_id_add(osl_statement_p statement, int k, int x) {
+inline void statement_id_add(osl_statement_p statement, int k, int x) {
     int row = find_row(statement->scattering, 2 * k);
     int constant_pos = statement->scattering->nb_columns - 1;
     osl_int_add_si(statement->scattering->precision,
@@ -107,7 +111,7 @@ void statement_id_add(osl_statement_p statement, int k, int x) {
                    statement->scattering->m[row][constant_pos], x);
 }
 
-bool in_loop(vector<int> loop_id, vector<int> statement_id) {
+inline bool in_loop(vector<int> loop_id, vector<int> statement_id) {
     int d_pos;
     id_compare(loop_id, statement_id, d_pos);
     return d_pos == loop_id.size();
@@ -115,7 +119,7 @@ bool in_loop(vector<int> loop_id, vector<int> statement_id) {
 
 // check if the given id is a loop
 // the given loop id length should be shorter
-bool check_is_loop(osl_scop_p scop, vector<int> loop_id) {
+inline bool check_is_loop(osl_scop_p scop, vector<int> loop_id) {
     for (auto statement = scop->statement; statement != NULL;
          statement = statement->next) {
         auto id = get_statementID(statement->scattering);
@@ -129,7 +133,7 @@ bool check_is_loop(osl_scop_p scop, vector<int> loop_id) {
 }
 
 // find the next loop's id (next to the given loop_id, and the same level)
-vector<int> get_next_loop(osl_scop_p scop, vector<int> loop_id) {
+inline vector<int> get_next_loop(osl_scop_p scop, vector<int> loop_id) {
     vector<int> next_loop_id = loop_id;
     next_loop_id[loop_id.size() - 1] += 1;
     if (check_is_loop(scop, next_loop_id)) {
@@ -139,7 +143,7 @@ vector<int> get_next_loop(osl_scop_p scop, vector<int> loop_id) {
 }
 
 // find the max id matching the loop-id prefix
-vector<int> find_max_in_loop(osl_scop_p scop, vector<int> loop_id) {
+inline vector<int> find_max_in_loop(osl_scop_p scop, vector<int> loop_id) {
     vector<int> max_id;
     for (auto statement = scop->statement; statement != NULL;
          statement = statement->next) {
@@ -163,7 +167,7 @@ vector<int> find_max_in_loop(osl_scop_p scop, vector<int> loop_id) {
     return max_id;
 }
 
-bool check_name_exist(osl_scatnames_p scat, char* str) {
+inline bool check_name_exist(osl_scatnames_p scat, char* str) {
     char** ptr = scat->names->string;
     while (*ptr != NULL) {
         if (strcmp(*ptr, str) == 0) {
@@ -174,56 +178,193 @@ bool check_name_exist(osl_scatnames_p scat, char* str) {
     return false;
 }
 
-int stripmine(osl_scop_p scop, vector<int> loop_id, unsigned int depth,
-              unsigned int size) {
+// substitute c = factor * c' + offset for the output dimension col
+// (0-based) in every row of the scattering
+inline void substitute_dim(osl_relation_p scattering, int col, int factor,
+                           int offset) {
+    int precision = scattering->precision;
+    int constant_pos = scattering->nb_columns - 1;
+    osl_int_t t;
+    osl_int_init(precision, &t);
+    for (int row = 0; row < scattering->nb_rows; ++row) {
+        auto m = scattering->m[row];
+        osl_int_mul_si(precision, &t, m[col + 1], offset);
+        osl_int_add(precision, &m[constant_pos], m[constant_pos], t);
+        osl_int_mul_si(precision, &m[col + 1], m[col + 1], factor);
+    }
+    osl_int_clear(precision, &t);
+}
+
+// whether CLooG prints OpenMP loops for the scop (osl_loop extension),
+// their bounds go through the variables lbp and ubp
+inline bool has_omp_loops(osl_scop_p scop) {
+    osl_loop_p loop =
+        (osl_loop_p)osl_generic_lookup(scop->extension, OSL_URI_LOOP);
+    for (; loop != NULL; loop = loop->next)
+        if (loop->directive & OSL_LOOP_DIRECTIVE_PARALLEL) return true;
+    return false;
+}
+
+// renumber the statements of the loop annotations once statements were
+// removed or copied: numbers[k] holds the new numbers of statement k + 1
+// and of its copies, it is empty if the statement was removed
+inline void renumber_loops(osl_scop_p scop,
+                           const vector<vector<int>>& numbers) {
+    osl_loop_p loop =
+        (osl_loop_p)osl_generic_lookup(scop->extension, OSL_URI_LOOP);
+    for (; loop != NULL; loop = loop->next) {
+        vector<int> ids;
+        for (size_t i = 0; i < loop->nb_stmts; ++i) {
+            int id = loop->stmt_ids[i];
+            if (id >= 1 && id <= (int)numbers.size())
+                ids.insert(ids.end(), numbers[id - 1].begin(),
+                           numbers[id - 1].end());
+        }
+        sort(ids.begin(), ids.end());
+        if (ids.size() > loop->nb_stmts)
+            loop->stmt_ids =
+                (int*)realloc(loop->stmt_ids, sizeof(int) * ids.size());
+        copy(ids.begin(), ids.end(), loop->stmt_ids);
+        loop->nb_stmts = ids.size();
+    }
+}
+
+// same once statements were removed: number[k] is the new number of
+// statement k + 1, 0 if removed
+inline void renumber_loops(osl_scop_p scop, const vector<int>& number) {
+    vector<vector<int>> numbers(number.size());
+    for (size_t k = 0; k < number.size(); ++k)
+        if (number[k] > 0) numbers[k].push_back(number[k]);
+    renumber_loops(scop, numbers);
+}
+
+// same once a command inserted copies of statements: before is the
+// statement list it started from, origin[copy] the statement a copy was
+// made from; a copy runs in the loops of its statement (or in a loop on
+// a part of its iterations), so it takes its annotations
+inline void renumber_copies(
+    osl_scop_p scop, const vector<osl_statement_p>& before,
+    const map<osl_statement_p, osl_statement_p>& origin) {
+    if (osl_generic_lookup(scop->extension, OSL_URI_LOOP) == NULL) return;
+    map<osl_statement_p, int> index;
+    for (size_t k = 0; k < before.size(); ++k) index[before[k]] = k;
+    vector<vector<int>> numbers(before.size());
+    int number = 1;
+    for (auto s = scop->statement; s != NULL; s = s->next, ++number) {
+        auto copy = origin.find(s);
+        auto it = index.find(copy == origin.end() ? s : copy->second);
+        if (it != index.end()) numbers[it->second].push_back(number);
+    }
+    renumber_loops(scop, numbers);
+}
+
+// the statement list of a scop, in order
+inline vector<osl_statement_p> statement_list(osl_scop_p scop) {
+    vector<osl_statement_p> list;
+    for (auto s = scop->statement; s != NULL; s = s->next) list.push_back(s);
+    return list;
+}
+
+// one tile level on the packed scattering: c at col splits into the strip
+// counter and c itself, -size * strip + c >= 0 and size * strip - c +
+// size - 1 >= 0
+inline void stripmine_packed(CompactRelation& scattering, int col,
+                             long long size) {
+    int row = scattering.find_row(col);
+
+    // insert new lines and columns
+    scattering.insert_columns(col + 1, 2);
+    scattering.insert_rows(row, 3);
+    int constant_pos = scattering.nb_columns - 1;
+
+    scattering.at(row + 0, col + 1) = -1;
+    scattering.at(row + 1, col + 2) = -size;
+    scattering.at(row + 2, col + 2) = size;
+    scattering.at(row + 2, constant_pos) = size - 1;
+
+    // inquality
+    scattering.at(row + 1, 0) = 1;
+    scattering.at(row + 2, 0) = 1;
+
+    // dependences
+    scattering.at(row + 1, col + 4) = 1;
+    scattering.at(row + 2, col + 4) = -1;
+
+    scattering.nb_output_dims += 2;
+
+    // reorder
+    int row_next = scattering.find_row(col + 2);
+    scattering.at(row, constant_pos) = scattering.at(row_next, constant_pos);
+    scattering.at(row_next, constant_pos) = 0;
+}
+
+// same in place on the osl_relation, for the entries beyond a native int
+inline void stripmine_relation(osl_relation_p scattering, int col, int size) {
+    auto precision = scattering->precision;
+    int row = find_row(scattering, col);
+
+    // insert new lines and columns
+    osl_relation_insert_blank_column(scattering, col + 1);
+    osl_relation_insert_blank_column(scattering, col + 1);
+
+    osl_relation_insert_blank_row(scattering, row);
+    osl_relation_insert_blank_row(scattering, row);
+    osl_relation_insert_blank_row(scattering, row);
+
+    osl_int_set_si(precision, &scattering->m[row + 0][col + 1], -1);
+    osl_int_set_si(precision, &scattering->m[row + 1][col + 2], -size);
+    osl_int_set_si(precision, &scattering->m[row + 2][col + 2], size);
+    osl_int_set_si(precision,
+                   &scattering->m[row + 2][scattering->nb_columns - 1],
+                   size - 1);
+
+    // inquality
+    osl_int_set_si(precision, &scattering->m[row + 1][0], 1);
+    osl_int_set_si(precision, &scattering->m[row + 2][0], 1);
+
+    // dependences
+    osl_int_set_si(precision, &scattering->m[row + 1][col + 4], 1);
+    osl_int_set_si(precision, &scattering->m[row + 2][col + 4], -1);
+
+    scattering->nb_output_dims += 2;
+
+    // reorder
+    int row_next = find_row(scattering, col + 2);
+    osl_int_assign(precision,
+                   &scattering->m[row][scattering->nb_columns - 1],
+                   scattering->m[row_next][scattering->nb_columns - 1]);
+    osl_int_set_si(precision,
+                   &scattering->m[row_next][scattering->nb_columns - 1], 0);
+}
+
+inline int stripmine(osl_scop_p scop, vector<int> loop_id,
+                     unsigned int depth, unsigned int size) {
     int col = (depth - 1) * 2;
+    // the new entries are -1, 1, size, -size and size - 1
+    if (size > INT_MAX) {
+        cerr << "stripmine: size too large" << endl;
+        return -1;
+    }
+
     for (auto statement = scop->statement; statement != NULL;
          statement = statement->next) {
-        auto scattering = statement->scattering;
-        auto statement_id = get_statementID(scattering);
-        auto precision = scattering->precision;
-        if (in_loop(loop_id, statement_id)) {
-            int row = find_row(scattering, col);
-
-            // insert new lines and columns
-            // cerr << "col : " << col << endl;
-            osl_relation_insert_blank_column(scattering, col + 1);
-            osl_relation_insert_blank_column(scattering, col + 1);
-
-            osl_relation_insert_blank_row(scattering, row);
-            osl_relation_insert_blank_row(scattering, row);
-            osl_relation_insert_blank_row(scattering, row);
-
-            osl_int_set_si(precision, &scattering->m[row + 0][col + 1], -1);
-            osl_int_set_si(precision, &scattering->m[row + 1][col + 2], -size);
-            osl_int_set_si(precision, &scattering->m[row + 2][col + 2], size);
-            osl_int_set_si(precision,
-                           &scattering->m[row + 2][scattering->nb_columns - 1],
-                           size - 1);
-
-            // inquality
-            osl_int_set_si(precision, &scattering->m[row + 1][0], 1);
-            osl_int_set_si(precision, &scattering->m[row + 2][0], 1);
-
-            // dependences
-            osl_int_set_si(precision, &scattering->m[row + 1][col + 4], 1);
-            osl_int_set_si(precision, &scattering->m[row + 2][col + 4], -1);
-
-            scattering->nb_output_dims += 2;
-
-            // reorder
-            int row_next = find_row(scattering, col + 2);
-            osl_int_assign(precision,
-                           &scattering->m[row][scattering->nb_columns - 1],
-                           scattering->m[row_next][scattering->nb_columns - 1]);
-            osl_int_set_si(precision,
-                           &scattering->m[row_next][scattering->nb_columns - 1],
-                           0);
+        if (!in_loop(loop_id, get_statementID(statement->scattering)))
+            continue;
+        // packed when every entry fits a native int, a single new
+        // relation instead of five reallocations of the osl_int_t matrix
+        CompactRelation packed;
+        if (packed.load(statement->scattering)) {
+            stripmine_packed(packed, col, size);
+            packed.store(&statement->scattering);
+        } else {
+            stripmine_relation(statement->scattering, col, size);
         }
     }
 
     osl_scatnames_p scat =
         (osl_scatnames_p)osl_generic_lookup(scop->extension, OSL_URI_SCATNAMES);
+    // without names there is nothing to name the new dimensions after
+    if (scat == NULL || scat->names == NULL) return 0;
     osl_strings_p names = scat->names;
 
     char buffer[128];
@@ -6,11 +6,11 @@ for root, dirs, files in os.walk('.'):
         if filename.endswith('.clay.scop'):
             filelist.append(os.path.join(root, filename))
 
-os.system('g++ ../src/codegen.cpp -lcloog-isl -lclan -losl -o ./codegen')
+# codegen links against libgpt, build it with the Makefile
+if os.system('make -C .. build') != 0:
+    raise SystemExit('make build failed')
 
 for filename in filelist:
-    os.system('./codegen ' + filename + ' ' + filename[:-5] + '.clay.c')
-
-os.system('rm codegen')
+    os.system('../build/codegen ' + filename + ' ' + filename[:-5] + '.clay.c')
 
 print(filelist)
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma scop
+/* Clay
+   autofuse([]);
+*/
+for(i = 0 ; i <= N ; i++) {
+  a[i] = 0;
+}
+for(i = 0 ; i <= N ; i++) {
+  b[i] = a[i];
+}
+#pragma endscop
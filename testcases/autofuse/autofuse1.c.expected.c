@@ -0,0 +1,6 @@
+if (N >= 0) {
+  for (i=0;i<=N;i++) {
+    a[i] = 0;
+    b[i] = a[i];
+  }
+}
@@ -0,0 +1,9 @@
+#pragma scop
+/* Clay
+   distribute([0]);
+*/
+for(i = 1 ; i <= N ; i++) {
+  a[i] = b[i];
+  c[i] = c[i-1] + a[i];
+}
+#pragma endscop
@@ -0,0 +1,8 @@
+if (N >= 1) {
+  for (i=1;i<=N;i++) {
+    a[i] = b[i];
+  }
+  for (i=1;i<=N;i++) {
+    c[i] = c[i-1] + a[i];
+  }
+}
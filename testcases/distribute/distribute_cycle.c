@@ -0,0 +1,9 @@
+#pragma scop
+/* Clay
+   distribute([0]);
+*/
+for(i = 1 ; i <= N ; i++) {
+  a[i] = c[i-1];
+  c[i] = a[i];
+}
+#pragma endscop
@@ -0,0 +1,8 @@
+#pragma scop
+/* Clay
+   index_set_split([0], [0, 10]);
+*/
+for(i = 0 ; i <= N ; i++) {
+  a[i] = 0;
+}
+#pragma endscop
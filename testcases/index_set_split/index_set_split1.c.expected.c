@@ -0,0 +1,8 @@
+if (N >= 0) {
+  for (i=0;i<=min(9,N);i++) {
+    a[i] = 0;
+  }
+  for (i=10;i<=N;i++) {
+    a[i] = 0;
+  }
+}
@@ -0,0 +1,11 @@
+#pragma scop
+/* Clay
+   index_set_split([0,0], [1, -2]);
+*/
+for(i = 0 ; i <= N ; i++) {
+  for(j = 0 ; j <= N ; j++) {
+    a[i][j] = 0;
+    b[i][j] = 0;
+  }
+}
+#pragma endscop
@@ -0,0 +1,8 @@
+if (N >= 0) {
+  for (i=0;i<=min(1,N);i++) {
+    a[i] = 0;
+  }
+  for (i=2;i<=N;i++) {
+    a[i] = 0;
+  }
+}
@@ -0,0 +1,10 @@
+#pragma scop
+/* Clay
+   permute([0]);
+*/
+for(i = 0 ; i <= N ; i++) {
+  for(j = 0 ; j <= N ; j++) {
+    a[j][i] = 0;
+  }
+}
+#pragma endscop
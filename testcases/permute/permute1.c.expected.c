@@ -0,0 +1,7 @@
+if (N >= 0) {
+  for (j=0;j<=N;j++) {
+    for (i=0;i<=N;i++) {
+      a[j][i] = 0;
+    }
+  }
+}
@@ -0,0 +1,15 @@
+#pragma scop
+/* Clay
+   permute([]);
+*/
+for(i = 0 ; i <= N ; i++) {
+  for(j = 0 ; j <= N ; j++) {
+    a[i][j] = b[j][i];
+  }
+}
+for(i = 0 ; i <= N ; i++) {
+  for(j = 0 ; j <= N ; j++) {
+    c[j][i] = 0;
+  }
+}
+#pragma endscop
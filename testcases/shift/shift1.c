@@ -0,0 +1,9 @@
+#pragma scop
+/* Clay
+   shift([0,1], 1, 1);
+*/
+for(i = 1 ; i <= N ; i++) {
+  a[i] = 0;
+  b[i] = a[i-1];
+}
+#pragma endscop
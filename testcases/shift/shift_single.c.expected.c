@@ -0,0 +1,5 @@
+if (N >= 0) {
+  for (i=1;i<=N+1;i++) {
+    a[(i-1)] = 0;
+  }
+}
@@ -0,0 +1,7 @@
+if (N >= 0) {
+  for (__ii0=0;__ii0<=floord(N,4);__ii0++) {
+    for (i=4*__ii0;i<=min(N,4*__ii0+3);i++) {
+      a[i] = 0;
+    }
+  }
+}
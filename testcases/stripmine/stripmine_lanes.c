@@ -0,0 +1,8 @@
+#pragma scop
+/* Clay
+   stripmine([0], 1, 6, 4);
+*/
+for(i = 0 ; i <= N ; i++) {
+  a[i] = 0;
+}
+#pragma endscop
@@ -0,0 +1,11 @@
+#pragma scop
+/* Clay
+   unroll_jam([0,0], 2, 3);
+*/
+for(i = 0 ; i <= N ; i++) {
+  for(j = 0 ; j <= N ; j++) {
+    a[i][j] = 0;
+    b[i][j] = 0;
+  }
+}
+#pragma endscop
@@ -0,0 +1,10 @@
+if (N >= 0) {
+  for (i=0;i<=N;i++) {
+    for (j=0;j<=N;j++) {
+      a[(2*i)][j] = 0;
+      b[(2*i)][j] = 0;
+      a[(2*i+1)][j] = 0;
+      b[(2*i+1)][j] = 0;
+    }
+  }
+}
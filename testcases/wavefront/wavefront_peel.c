@@ -0,0 +1,14 @@
+#pragma scop
+/* Clay
+   wavefront([1], 1);
+   peel([0], 1);
+*/
+for(i = 0 ; i <= N ; i++) {
+  b[i] = 0;
+}
+for(i = 1 ; i <= N ; i++) {
+  for(j = 1 ; j <= N ; j++) {
+    a[i][j] = a[i-1][j] + a[i][j-1];
+  }
+}
+#pragma endscop